@@ -3,6 +3,7 @@
 
 #include "types.h"
 #include "hls_math.h"
+#include <utility>
 
 static ssm_t exp_lut_approx(ssm_t val) {
     #pragma HLS INLINE
@@ -14,7 +15,8 @@ static ssm_t exp_lut_approx(ssm_t val) {
         0.0024, 0.0015, 0.0009, 0.0005,
         0.0000, 0.0000 
     };
-    #pragma HLS BIND_STORAGE variable=lut_values type=rom_1p impl=bram
+    // Registers, not a 1-port BRAM ROM: every vector lane does two lookups per clock
+    #pragma HLS ARRAY_PARTITION variable=lut_values complete
 
     if (val < 0) return 1.0;
     if (val > 8) return 0.0;
@@ -53,4 +55,80 @@ static ssm_t silu_approx(ssm_t x) {
     return x * sig;
 }
 
+
+// Fixed-point reciprocal square root shared by the norm stages (RMSNorm and the PVM
+// LayerNorms), replacing the float divide and sqrt. The operand is normalized by its
+// leading one to m in [1, 4) with an even shift k, so 1/sqrt(v) = 1/sqrt(m) * 2^(-k/2).
+// A table indexed by the top RSQRT_LUT_BITS bits of m seeds 1/sqrt(m), and each of the
+// RSQRT_NEWTON iterations y = y * (1.5 - m*y*y/2) roughly squares the relative error.
+// Accuracy / latency over every positive ssm_t operand, against the float path:
+//   6 bits, 1 iteration (default): within 1 LSB of ssm_t
+//   4 bits, 2 iterations:          exact, two more multiplies in series
+//   10 bits, 0 iterations:         within 8 LSB (2.5e-4 relative), table lookup only
+#ifndef RSQRT_LUT_BITS
+#define RSQRT_LUT_BITS 6
+#endif
+#ifndef RSQRT_NEWTON
+#define RSQRT_NEWTON 1
+#endif
+const int RSQRT_LUT_SIZE = 1 << RSQRT_LUT_BITS;
+
+typedef ap_ufixed<32, 16> rsqrt_in_t;  // Mean-square / variance operand (epsilon added here)
+typedef ap_ufixed<24, 2> rsqrt_mant_t; // Normalized operand m in [1, 4)
+typedef ap_ufixed<24, 1> rsqrt_y_t;    // 1/sqrt(m) in (0.5, 1]
+
+// Table entry i: 1/sqrt of the midpoint of its segment, [1, 2) in RSQRT_LUT_SIZE steps
+// followed by [2, 4) in RSQRT_LUT_SIZE steps (evaluated at compile time)
+constexpr double rsqrt_seed(int i) {
+    double m = (i < RSQRT_LUT_SIZE) ? 1.0 + (i + 0.5) / RSQRT_LUT_SIZE
+                                    : 2.0 + 2.0 * (i - RSQRT_LUT_SIZE + 0.5) / RSQRT_LUT_SIZE;
+    double y = 0.5;
+    for (int k = 0; k < 32; k++) y = y * (1.5 - 0.5 * m * y * y);
+    return y;
+}
+
+template<typename SEQ> struct rsqrt_lut;
+template<int... I> struct rsqrt_lut<std::integer_sequence<int, I...>> {
+    static const rsqrt_y_t table[sizeof...(I)];
+};
+template<int... I>
+const rsqrt_y_t rsqrt_lut<std::integer_sequence<int, I...>>::table[sizeof...(I)] = {rsqrt_y_t(rsqrt_seed(I))...};
+
+typedef rsqrt_lut<std::make_integer_sequence<int, 2 * RSQRT_LUT_SIZE>> rsqrt_seeds;
+
+static ssm_t rsqrt_fixed(rsqrt_in_t v) {
+    #pragma HLS INLINE
+
+    // 0 has no inverse root: saturate like the float path's +inf
+    if (v == 0) return (ssm_t)256;
+
+    // Leading one: e = floor(log2(v)), then round down to an even shift
+    int e = -16;
+    for (int b = -15; b < 16; b++) {
+        #pragma HLS UNROLL
+        rsqrt_in_t bound = (b >= 0) ? (rsqrt_in_t)(rsqrt_in_t(1) << b) : (rsqrt_in_t)(rsqrt_in_t(1) >> -b);
+        if (v >= bound) e = b;
+    }
+    const int k = e & ~1;
+    rsqrt_mant_t m = (k >= 0) ? (rsqrt_mant_t)(v >> k) : (rsqrt_mant_t)(v << -k);
+
+    int idx;
+    if (m < 2) idx = (int)((m - 1) << RSQRT_LUT_BITS);
+    else       idx = RSQRT_LUT_SIZE + (int)((m - 2) << (RSQRT_LUT_BITS - 1));
+    rsqrt_y_t y = rsqrt_seeds::table[idx];
+
+    for (int it = 0; it < RSQRT_NEWTON; it++) {
+        #pragma HLS UNROLL
+        ap_ufixed<28, 3> my2 = m * y * y;
+        ap_fixed<28, 3> corr = ap_fixed<28, 3>(1.5) - (my2 >> 1);
+        y = y * corr;
+    }
+
+    // Undo the normalization: * 2^(-k/2)
+    const int h = k / 2;
+    ap_ufixed<40, 12> r = y;
+    r = (h >= 0) ? (ap_ufixed<40, 12>)(r >> h) : (ap_ufixed<40, 12>)(r << -h);
+    return (ssm_t)r;
+}
+
 #endif
\ No newline at end of file
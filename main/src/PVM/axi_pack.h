@@ -0,0 +1,147 @@
+#ifndef AXI_PACK_H
+#define AXI_PACK_H
+
+#include <ap_int.h>
+#include "types.h"
+#include "hls_stream.h"
+
+// Packed memory-port words. One AXI beat of PVM_AXI_BITS carries AXI_VALS ssm_t values:
+// value i sits in bits [i * SSM_BITS, (i + 1) * SSM_BITS), the spare top bits are zero,
+// and a tensor's last word is zero-padded. Tensors start on a word boundary.
+#ifndef PVM_AXI_BITS
+#define PVM_AXI_BITS 512
+#endif
+static_assert(PVM_AXI_BITS == 128 || PVM_AXI_BITS == 256 || PVM_AXI_BITS == 512,
+              "PVM_AXI_BITS must be 128, 256 or 512");
+
+// Longest burst that stays within one 4 KB AXI page, and bursts kept in flight
+#if PVM_AXI_BITS == 512
+#define PVM_AXI_BURST 64
+#elif PVM_AXI_BITS == 256
+#define PVM_AXI_BURST 128
+#else
+#define PVM_AXI_BURST 256
+#endif
+#define PVM_AXI_OUTSTANDING 16
+
+typedef ap_uint<PVM_AXI_BITS> axi_word_t;
+const int SSM_BITS = ssm_t::width;
+const int AXI_VALS = PVM_AXI_BITS / SSM_BITS; // 7, 14 or 28 values per beat
+
+// Words holding an n-value tensor
+constexpr int axi_words(int n) { return (n + AXI_VALS - 1) / AXI_VALS; }
+
+// Packed 8-bit pixels: AXI_PIXELS 32-bit pixels per word, pixel p in bits [32p, 32p + 32)
+// holding R, G, B, A in bytes 0 .. 3
+const int AXI_PIXELS = PVM_AXI_BITS / 32;
+constexpr int axi_pixel_words(int n) { return (n + AXI_PIXELS - 1) / AXI_PIXELS; }
+
+inline int axi_get_byte(const axi_word_t &word, int p, int c) {
+    #pragma HLS INLINE
+    return word.range(32 * p + 8 * c + 7, 32 * p + 8 * c).to_int();
+}
+
+inline ssm_t axi_get(const axi_word_t &word, int i) {
+    #pragma HLS INLINE
+    ssm_t v;
+    v.range(SSM_BITS - 1, 0) = word.range((i + 1) * SSM_BITS - 1, i * SSM_BITS);
+    return v;
+}
+
+inline void axi_set(axi_word_t &word, int i, ssm_t v) {
+    #pragma HLS INLINE
+    word.range((i + 1) * SSM_BITS - 1, i * SSM_BITS) = v.range(SSM_BITS - 1, 0);
+}
+
+// Pack N bytes, PVM_AXI_BITS / 8 per word
+template<int N>
+void axi_pack_bytes(hls::stream<ap_uint<8> > &in_stream, hls::stream<axi_word_t> &out_stream) {
+    #pragma HLS INLINE off
+    const int PER_WORD = PVM_AXI_BITS / 8;
+    axi_word_t word = 0;
+    int k = 0;
+    for (int i = 0; i < N; i++) {
+        #pragma HLS PIPELINE II=1
+        word.range(8 * k + 7, 8 * k) = in_stream.read();
+        if (k == PER_WORD - 1 || i == N - 1) {
+            out_stream.write(word);
+            word = 0;
+            k = 0;
+        } else {
+            k++;
+        }
+    }
+}
+
+// Pack N flags, one bit each (set where the byte is not 0), PVM_AXI_BITS per word
+template<int N>
+void axi_pack_bits(hls::stream<ap_uint<8> > &in_stream, hls::stream<axi_word_t> &out_stream) {
+    #pragma HLS INLINE off
+    axi_word_t word = 0;
+    int k = 0;
+    for (int i = 0; i < N; i++) {
+        #pragma HLS PIPELINE II=1
+        word[k] = (in_stream.read() != 0);
+        if (k == PVM_AXI_BITS - 1 || i == N - 1) {
+            out_stream.write(word);
+            word = 0;
+            k = 0;
+        } else {
+            k++;
+        }
+    }
+}
+
+// Burst-read / burst-write N words between a memory port and a word stream
+template<int N>
+void axi_read_words(const axi_word_t *src, hls::stream<axi_word_t> &out_stream) {
+    #pragma HLS INLINE off
+    for (int i = 0; i < N; i++) {
+        #pragma HLS PIPELINE II=1
+        out_stream.write(src[i]);
+    }
+}
+
+template<int N>
+void axi_write_words(hls::stream<axi_word_t> &in_stream, axi_word_t *dst) {
+    #pragma HLS INLINE off
+    for (int i = 0; i < N; i++) {
+        #pragma HLS PIPELINE II=1
+        dst[i] = in_stream.read();
+    }
+}
+
+// Unpack an N-value tensor: one value per cycle, a new word every AXI_VALS values
+template<int N>
+void axi_unpack(hls::stream<axi_word_t> &in_stream, hls::stream<ssm_t> &out_stream) {
+    #pragma HLS INLINE off
+    axi_word_t word = 0;
+    int k = 0;
+    for (int i = 0; i < N; i++) {
+        #pragma HLS PIPELINE II=1
+        if (k == 0) word = in_stream.read();
+        out_stream.write(axi_get(word, k));
+        if (++k == AXI_VALS) k = 0;
+    }
+}
+
+// Pack an N-value tensor, flushing a word when it is full and after the last value
+template<int N>
+void axi_pack(hls::stream<ssm_t> &in_stream, hls::stream<axi_word_t> &out_stream) {
+    #pragma HLS INLINE off
+    axi_word_t word = 0;
+    int k = 0;
+    for (int i = 0; i < N; i++) {
+        #pragma HLS PIPELINE II=1
+        axi_set(word, k, in_stream.read());
+        if (k == AXI_VALS - 1 || i == N - 1) {
+            out_stream.write(word);
+            word = 0;
+            k = 0;
+        } else {
+            k++;
+        }
+    }
+}
+
+#endif
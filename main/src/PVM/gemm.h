@@ -0,0 +1,131 @@
+#ifndef GEMM_H
+#define GEMM_H
+
+#include "types.h"
+
+// Tiled GEMV engine shared by the linear projections (PVM output projection, Mamba
+// block projections). It computes y = W x + b for an n_out x n_in matrix on a
+// pe_rows x pe_cols grid of MACs. Each cycle the grid consumes one weight tile and
+// pe_cols inputs, and each row PE keeps its running sum in accum_t. A product therefore
+// takes (n_out / pe_rows) * (n_in / pe_cols) cycles: throughput scales with the PE
+// count, and storage needs pe_rows * pe_cols banks instead of a fully partitioned matrix.
+//
+// Callers partition W cyclic by pe_rows on its row dimension and by pe_cols on its
+// column dimension, x cyclic by pe_cols and y cyclic by pe_rows.
+
+// Default accumulator: a product of two ssm_t operands needs up to 16 integer bits and
+// 20 fraction bits, so a 512-term dot product needs 25 integer bits. 28 integer bits and
+// 20 fraction bits hold it exactly, and 48 bits is the DSP48 accumulator width, so the
+// PEs cost no extra DSPs. Only the final cast to the output type saturates.
+typedef ap_fixed<48, 28, AP_RND, AP_SAT> gemm_accum_t;
+static_assert(2 * ssm_t::iwidth + 9 <= gemm_accum_t::iwidth &&
+              2 * (ssm_t::width - ssm_t::iwidth) <= gemm_accum_t::width - gemm_accum_t::iwidth,
+              "gemm_accum_t must hold a 512-term ssm_t dot product exactly");
+
+template<int N_OUT, int N_IN, int PE_ROWS, int PE_COLS, typename ACCUM_T = gemm_accum_t>
+struct gemm_config {
+    static const int n_out = N_OUT;
+    static const int n_in = N_IN;
+    static const int pe_rows = PE_ROWS;
+    static const int pe_cols = PE_COLS;
+    static const int row_tiles = (N_OUT + PE_ROWS - 1) / PE_ROWS;
+    static const int col_tiles = (N_IN + PE_COLS - 1) / PE_COLS;
+    typedef ACCUM_T accum_t;
+};
+
+// One grid cycle: column tile ct of row tile rt. Row PE pr accumulates into acc[pr],
+// starting from zero on the first column tile. n_out / n_in are the live dimensions
+// (at most CONFIG_T's), so a grid sized for the largest layer also serves smaller ones.
+template<typename CONFIG_T, typename T>
+void gemv_tile_step(
+    const T w[CONFIG_T::n_out][CONFIG_T::n_in],
+    const T x[CONFIG_T::n_in],
+    typename CONFIG_T::accum_t acc[CONFIG_T::pe_rows],
+    int rt, int ct, int n_out, int n_in
+) {
+    #pragma HLS INLINE
+    typedef typename CONFIG_T::accum_t accum_t;
+    for (int pr = 0; pr < CONFIG_T::pe_rows; pr++) {
+        #pragma HLS UNROLL
+        const int r = rt * CONFIG_T::pe_rows + pr;
+        accum_t sum = (ct == 0) ? (accum_t)0 : acc[pr];
+        for (int pc = 0; pc < CONFIG_T::pe_cols; pc++) {
+            #pragma HLS UNROLL
+            const int c = ct * CONFIG_T::pe_cols + pc;
+            if (r < n_out && c < n_in) sum += (accum_t)(w[r][c] * x[c]);
+        }
+        acc[pr] = sum;
+    }
+}
+
+// Grid cycles for one n_out x n_in product
+template<typename CONFIG_T>
+int gemv_tiles(int n_out, int n_in) {
+    #pragma HLS INLINE
+    return ((n_out + CONFIG_T::pe_rows - 1) / CONFIG_T::pe_rows) *
+           ((n_in + CONFIG_T::pe_cols - 1) / CONFIG_T::pe_cols);
+}
+
+// Product y = W x over the live n_out x n_in corner, without bias. Matrix products
+// run it once per column of the right-hand operand.
+template<typename CONFIG_T, typename T, typename Y_T>
+void gemv_tiled_live(
+    const T w[CONFIG_T::n_out][CONFIG_T::n_in],
+    const T x[CONFIG_T::n_in],
+    Y_T y[CONFIG_T::n_out],
+    int n_out, int n_in
+) {
+    #pragma HLS INLINE
+    typename CONFIG_T::accum_t acc[CONFIG_T::pe_rows];
+    #pragma HLS ARRAY_PARTITION variable=acc complete
+
+    const int col_tiles = (n_in + CONFIG_T::pe_cols - 1) / CONFIG_T::pe_cols;
+    int rt = 0, ct = 0;
+    for (int i = 0; i < gemv_tiles<CONFIG_T>(n_out, n_in); i++) {
+        #pragma HLS PIPELINE II=1
+        #pragma HLS LOOP_TRIPCOUNT max=CONFIG_T::row_tiles*CONFIG_T::col_tiles
+        gemv_tile_step<CONFIG_T, T>(w, x, acc, rt, ct, n_out, n_in);
+        if (ct == col_tiles - 1) {
+            for (int pr = 0; pr < CONFIG_T::pe_rows; pr++) {
+                #pragma HLS UNROLL
+                const int r = rt * CONFIG_T::pe_rows + pr;
+                if (r < n_out) y[r] = (Y_T)acc[pr];
+            }
+        }
+        if (++ct == col_tiles) { ct = 0; rt++; }
+    }
+}
+
+// Whole product y = W x + b at the full CONFIG_T dimensions
+template<typename CONFIG_T, typename T>
+void gemv_tiled(
+    const T w[CONFIG_T::n_out][CONFIG_T::n_in],
+    const T b[CONFIG_T::n_out],
+    const T x[CONFIG_T::n_in],
+    T y[CONFIG_T::n_out]
+) {
+    // Inlined so the caller's partitioning (and bank select) applies directly
+    #pragma HLS INLINE
+    static_assert(CONFIG_T::n_out % CONFIG_T::pe_rows == 0, "n_out must be a multiple of pe_rows");
+    static_assert(CONFIG_T::n_in % CONFIG_T::pe_cols == 0, "n_in must be a multiple of pe_cols");
+
+    typename CONFIG_T::accum_t acc[CONFIG_T::pe_rows];
+    #pragma HLS ARRAY_PARTITION variable=acc complete
+
+    // Row tiles outer, column tiles inner, flattened into one II=1 pipeline
+    int rt = 0, ct = 0;
+    for (int i = 0; i < CONFIG_T::row_tiles * CONFIG_T::col_tiles; i++) {
+        #pragma HLS PIPELINE II=1
+        gemv_tile_step<CONFIG_T, T>(w, x, acc, rt, ct, CONFIG_T::n_out, CONFIG_T::n_in);
+        if (ct == CONFIG_T::col_tiles - 1) {
+            for (int pr = 0; pr < CONFIG_T::pe_rows; pr++) {
+                #pragma HLS UNROLL
+                const int r = rt * CONFIG_T::pe_rows + pr;
+                y[r] = (T)(acc[pr] + b[r]);
+            }
+        }
+        if (++ct == CONFIG_T::col_tiles) { ct = 0; rt++; }
+    }
+}
+
+#endif
@@ -3,16 +3,37 @@
 
 #include "hls_stream.h"
 #include "types.h"
+#include <string.h>
 
+template<int D>
 class ImagePreprocess {
 public:
     // Local constructor prevents linker "undefined symbol" errors
-    ImagePreprocess(int h, int w, int d) : H(h), W(w), D(d) {}
-    
-    void forward(const float *image, hls::stream<PixelVec> &out_stream);
+    ImagePreprocess(int h, int w) : H(h), W(w) {}
+
+    void forward(const float *image, hls::stream<PixelVec<D> > &out_stream) {
+        float local_buf[D];
+        #pragma HLS ARRAY_PARTITION variable=local_buf complete
+
+        int L = H * W;
+        for (int t = 0; t < L; t++) {
+            #pragma HLS PIPELINE II=1
+            // Burst read copies a block from DDR to local BRAM
+            // This prevents the AXI bus from locking up during DATAFLOW
+            memcpy(local_buf, image + (t * D), D * sizeof(float));
+
+            PixelVec<D> vec;
+            #pragma HLS ARRAY_PARTITION variable=vec.data complete
+            for (int d = 0; d < D; d++) {
+                #pragma HLS UNROLL
+                vec.data[d] = (ssm_t)local_buf[d];
+            }
+            out_stream.write(vec);
+        }
+    }
 
 private:
-    int H, W, D;
+    int H, W;
 };
 
-#endif
\ No newline at end of file
+#endif
@@ -2,167 +2,394 @@
 #define LAYERS_H
 
 #include "types.h"
-#include "hls_math.h"
 #include "activations.h"
 #include "hls_stream.h"
+#include "gemm.h"
+
+// OPTIMIZATION: Block weights are shared read-only tables rather than per-instance
+// members. Every branch and layer reads the same constants, so no VisionMambaBlock
+// instance carries its own partitioned register copy.
+#define VM_REP8(v)   v, v, v, v, v, v, v, v
+#define VM_REP64(v)  VM_REP8(v), VM_REP8(v), VM_REP8(v), VM_REP8(v), \
+                     VM_REP8(v), VM_REP8(v), VM_REP8(v), VM_REP8(v)
+#define VM_REP256(v) VM_REP64(v), VM_REP64(v), VM_REP64(v), VM_REP64(v)
+static_assert(VM_MAX_E == 256, "resize the weight table initializers with VM_MAX_E");
+
+const ssm_t RMS_NORM_WEIGHTS[VM_MAX_E] = { VM_REP256(1.0) };
+
+// Depthwise taps: [0] current token, [1] t-1, [2] t-2
+const ssm_t CONV1D_WEIGHTS[3][VM_MAX_E] = {
+    { VM_REP256(0.33) },
+    { VM_REP256(0.33) },
+    { VM_REP256(0.33) }
+};
+
+// MAC grids of the Mamba block projections (gemm.h), sized per block so a projection
+// finishes a token within the block's cycle budget (vm_config::token_cycles). A column
+// tile takes at most VM_PE_COLS inputs, or a whole input beat when the budget needs
+// it. The row count is then the fewest rows that fit the budget. When the output is
+// split into beats, the row count must also divide the beat so no tile straddles two
+// beats. A small or short-sequence block thus gets a grid narrowed to what its token
+// rate needs, and no PE is left idle. Each weight bank of a grid holds its
+// row_tiles * col_tiles words, so a grid never runs more tiles than VM_BANK_WORDS. That
+// keeps the working copies LUTRAM-sized when the budget alone would allow deeper banks.
+#ifndef VM_PE_COLS
+#define VM_PE_COLS 8
+#endif
+#ifndef VM_BANK_WORDS
+#define VM_BANK_WORDS 64
+#endif
+constexpr int vm_div_up(int a, int b) { return (a + b - 1) / b; }
+
+constexpr int vm_grid_rows(int n_out, int out_width, bool beat_aligned, int col_tiles, int cycles) {
+    int rows = vm_div_up(n_out, (cycles / col_tiles > 0) ? cycles / col_tiles : 1);
+    if (beat_aligned) {
+        while (rows < out_width && out_width % rows != 0) rows++;
+        if (rows > out_width) rows = out_width;
+    }
+    return rows;
+}
+
+constexpr int vm_grid_cols(int n_out, int n_in, int in_width, int out_width, bool beat_aligned, int cycles) {
+    if (in_width <= VM_PE_COLS) return in_width;
+    const int col_tiles = vm_div_up(n_in, VM_PE_COLS);
+    const int rows = vm_grid_rows(n_out, out_width, beat_aligned, col_tiles, cycles);
+    return (col_tiles * vm_div_up(n_out, rows) <= cycles) ? VM_PE_COLS : in_width;
+}
+
+template<int N_OUT, int N_IN, int IN_WIDTH, int OUT_WIDTH, bool BEAT_ALIGNED, int CYCLES,
+         int PE_COLS = vm_grid_cols(N_OUT, N_IN, IN_WIDTH, OUT_WIDTH, BEAT_ALIGNED, CYCLES)>
+struct vm_gemm {
+    typedef gemm_config<N_OUT, N_IN,
+                        vm_grid_rows(N_OUT, OUT_WIDTH, BEAT_ALIGNED, vm_div_up(N_IN, PE_COLS), CYCLES),
+                        PE_COLS> type;
+};
+
+// Compile-time geometry of one Mamba block: D-channel tokens of an H x W frame. Every
+// stage is specialized on it, so loop bounds, buffers and projection grids are exactly
+// the block's own and HLS sees constant trip counts throughout. TOKEN_CYCLES is the
+// block's budget per token. It defaults to the per-beat stages' own rate, TOKEN_II cycles
+// per beat of the E-wide stream. A block on a shorter sequence than its neighbours may be
+// given more (see pvm_config.h).
+template<int D_, int H_, int W_, int TOKEN_CYCLES_ = TOKEN_II * vec_tile<VM_EXPAND * D_>::beats>
+struct vm_config {
+    static const int d = D_;                  // model channels
+    static const int e = VM_EXPAND * D_;      // inner width
+    static const int h = H_;
+    static const int w = W_;
+    static const int seq_len = H_ * W_;
+    static const int x_rows = VM_DT_RANK + 2 * D_STATE; // x_proj: dt, B, C
+    static const int weights_size = vm_weights_size(D_);
+    static const int token_cycles = TOKEN_CYCLES_;
+
+    // Beat layout (types.h) of the block's D-wide and E-wide streams
+    static const int d_width = vec_tile<D_>::width;
+    static const int d_beats = vec_tile<D_>::beats;
+    static const int e_width = vec_tile<VM_EXPAND * D_>::width;
+    static const int e_beats = vec_tile<VM_EXPAND * D_>::beats;
+
+    // Grid cycles per token: the budget, capped at VM_BANK_WORDS. The parameter generator
+    // spends e_beats - 1 cycles per token past its last tile.
+    static const int grid_cycles = (token_cycles < VM_BANK_WORDS) ? token_cycles : VM_BANK_WORDS;
+    typedef typename vm_gemm<2 * e, d, d_width, e_width, (e_beats > 1), grid_cycles>::type in_proj_gemm;
+    typedef typename vm_gemm<x_rows, e, e_width, x_rows, false, grid_cycles - (e_beats - 1)>::type x_proj_gemm;
+    typedef typename vm_gemm<d, e, e_width, d_width, (d_beats > 1), grid_cycles>::type out_proj_gemm;
+
+    static_assert(D_ > 0 && H_ > 0 && W_ > 0, "empty Mamba block");
+    static_assert(e <= VM_MAX_E, "Mamba inner width exceeds the constant weight tables");
+    // Projections take input beats at column-tile boundaries and release output beats
+    // at row-tile boundaries, so a multi-beat token needs tiles that never straddle beats
+    static_assert((d_beats == 1 && e_beats == 1) || VEC_WIDTH % VM_PE_COLS == 0,
+                  "VM_PE_COLS must divide PVM_VEC_WIDTH");
+    static_assert(in_proj_gemm::row_tiles * in_proj_gemm::col_tiles <= token_cycles &&
+                  x_proj_gemm::row_tiles * x_proj_gemm::col_tiles + e_beats - 1 <= token_cycles &&
+                  out_proj_gemm::row_tiles * out_proj_gemm::col_tiles <= token_cycles,
+                  "Mamba projection grids cannot meet TOKEN_CYCLES; give the block a larger budget");
+};
 
 // --- Class 1: RMS Normalization ---
+// The mean square accumulates over a token's beats, which are buffered meanwhile. The
+// scaled beats leave from the cycle the last one arrives, so a one-beat token still
+// takes a single iteration.
+template<typename CONFIG_T>
 class RMSNorm {
-    int D;
-    ssm_t weights[32];
-
 public:
-    RMSNorm(int d) : D(d) {
-        // OPTIMIZATION: Fully partition the weights array so parallel unrolled reads don't stall
-        #pragma HLS ARRAY_PARTITION variable=weights complete
-        for(int i=0; i<32; i++) weights[i] = 1.0;
-    }
+    static const int D = CONFIG_T::d;
+    static const int W = CONFIG_T::d_width;
+    static const int BEATS = CONFIG_T::d_beats;
 
     void forward(
-        int L,
-        hls::stream<PixelVec> &in_stream,
-        hls::stream<PixelVec> &out_stream
+        hls::stream<PixelVec<W> > &in_stream,
+        hls::stream<PixelVec<W> > &out_stream
     ) {
-        for(int t=0; t<L; t++) {
+        // Mean-square scale, a constant of the channel count
+        const rsqrt_in_t inv_d = rsqrt_in_t(1.0 / D);
 
-            PixelVec in_vec = in_stream.read();
-            PixelVec out_vec;
+        ssm_t tok[D];
+        #pragma HLS ARRAY_PARTITION variable=tok cyclic factor=W
+        ssm_t sum_sq = 0;
+        ssm_t rsqrt = 0;
 
-            ssm_t sum_sq = 0;
-            for(int d=0; d<32; d++) {
-// OPTIMIZATION: Throttle unroll
-#pragma HLS PIPELINE II=1
-                if(d < D) sum_sq += in_vec.data[d] * in_vec.data[d];
-            }
-           
-            // OPTIMIZATION: Cast to float for DSP-friendly inverse square root
-            float temp_sum = (float)(sum_sq / ssm_t(D) + ssm_t(0.0001));
-            ssm_t rsqrt = (ssm_t)(1.0f / hls::sqrt(temp_sum));
+        // Beats 0 .. BEATS-1 come in, beats BEATS-1 .. 2*BEATS-2 go out
+        int b = 0;
+        for(int i=0; i<CONFIG_T::seq_len * (2 * BEATS - 1); i++) {
+// OPTIMIZATION: One beat every TOKEN_II cycles, LANES channels per clock
+#pragma HLS PIPELINE II=TOKEN_II
+            if (b < BEATS) {
+                PixelVec<W> in_vec = in_stream.read();
+                #pragma HLS ARRAY_PARTITION variable=in_vec.data cyclic factor=LANES
 
-            for(int d=0; d<32; d++) {
-#pragma HLS PIPELINE II=1
-                if(d < D) out_vec.data[d] = in_vec.data[d] * rsqrt * weights[d];
-                else      out_vec.data[d] = 0;
+                if (b == 0) sum_sq = 0;
+                for(int d=0; d<W; d++) {
+#pragma HLS UNROLL
+                    sum_sq += in_vec.data[d] * in_vec.data[d];
+                    tok[b * W + d] = in_vec.data[d];
+                }
+                // OPTIMIZATION: Fixed-point inverse square root, no float divide / sqrt
+                if (b == BEATS - 1) {
+                    rsqrt = rsqrt_fixed((rsqrt_in_t)(sum_sq * inv_d) + rsqrt_in_t(0.0001));
+                }
             }
-            out_stream.write(out_vec);
+            if (b >= BEATS - 1) {
+                const int c0 = (b - (BEATS - 1)) * W;
+                PixelVec<W> out_vec;
+                #pragma HLS ARRAY_PARTITION variable=out_vec.data cyclic factor=LANES
+                for(int d=0; d<W; d++) {
+#pragma HLS UNROLL
+                    out_vec.data[d] = tok[c0 + d] * rsqrt * RMS_NORM_WEIGHTS[c0 + d];
+                }
+                out_stream.write(out_vec);
+            }
+            if (++b == 2 * BEATS - 1) b = 0;
         }
     }
 };
 
 // --- Class 2: Input Projection ---
+// Learned in_proj, D -> 2E: the first E outputs feed the main branch, the last E the gate.
+// Input beats land in x as the first row tile's column tiles reach them, and an output
+// beat leaves once the row tile holding its last row is done.
+template<typename CONFIG_T>
 class InputProjection {
-    int D;
 public:
-    InputProjection(int d) : D(d) {}
+    static const int D = CONFIG_T::d;
+    static const int E = CONFIG_T::e;
+    static const int DW = CONFIG_T::d_width;
+    static const int EW = CONFIG_T::e_width;
+    static const int EB = CONFIG_T::e_beats;
+    typedef typename CONFIG_T::in_proj_gemm gemm_t;
 
     void forward(
-        int L,
-        hls::stream<PixelVec> &in_stream,
-        hls::stream<PixelVec> &main_branch,
-        hls::stream<PixelVec> &gate_branch
+        hls::stream<PixelVec<DW> > &in_stream,
+        hls::stream<PixelVec<EW> > &main_branch,
+        hls::stream<PixelVec<EW> > &gate_branch,
+        hls::stream<ssm_t> &weights
     ) {
-        for(int t=0; t<L; t++) {
+        ssm_t w[gemm_t::n_out][gemm_t::n_in];
+        #pragma HLS ARRAY_PARTITION variable=w cyclic factor=gemm_t::pe_rows dim=1
+        #pragma HLS ARRAY_PARTITION variable=w cyclic factor=gemm_t::pe_cols dim=2
+
+        int r = 0, c = 0;
+        for (int i = 0; i < 2 * E * D; i++) {
 #pragma HLS PIPELINE II=1
-            PixelVec x = in_stream.read();
-            main_branch.write(x);
-            gate_branch.write(x);
+            w[r][c] = weights.read();
+            if (++c == D) { c = 0; r++; }
+        }
+
+        // OPTIMIZATION: Token and tile loops flattened into one II=1 pipeline
+        gemm_accum_t acc[gemm_t::pe_rows];
+        #pragma HLS ARRAY_PARTITION variable=acc complete
+        ssm_t x[D];
+        PixelVec<EW> x_main, x_gate;
+        #pragma HLS ARRAY_PARTITION variable=x cyclic factor=DW
+        #pragma HLS ARRAY_PARTITION variable=x_main.data cyclic factor=gemm_t::pe_rows
+        #pragma HLS ARRAY_PARTITION variable=x_gate.data cyclic factor=gemm_t::pe_rows
+
+        int rt = 0, ct = 0, mb = 0, gb = 0;
+        for (int i = 0; i < CONFIG_T::seq_len * gemm_t::row_tiles * gemm_t::col_tiles; i++) {
+#pragma HLS PIPELINE II=1
+            if (rt == 0 && (ct * gemm_t::pe_cols) % DW == 0) {
+                PixelVec<DW> beat = in_stream.read();
+                for (int d = 0; d < DW; d++) {
+#pragma HLS UNROLL
+                    x[ct * gemm_t::pe_cols + d] = beat.data[d];
+                }
+            }
+            gemv_tile_step<gemm_t, ssm_t>(w, x, acc, rt, ct, 2 * E, D);
+            if (ct == gemm_t::col_tiles - 1) {
+                for (int pr = 0; pr < gemm_t::pe_rows; pr++) {
+#pragma HLS UNROLL
+                    int row = rt * gemm_t::pe_rows + pr;
+                    if (row < E)          x_main.data[row % EW] = (ssm_t)acc[pr];
+                    else if (row < 2 * E) x_gate.data[(row - E) % EW] = (ssm_t)acc[pr];
+                }
+                const int last_row = rt * gemm_t::pe_rows + gemm_t::pe_rows - 1;
+                if (mb < EB && last_row >= (mb + 1) * EW - 1) {
+                    main_branch.write(x_main);
+                    mb++;
+                }
+                if (gb < EB && last_row >= E + (gb + 1) * EW - 1) {
+                    gate_branch.write(x_gate);
+                    gb++;
+                }
+            }
+            if (++ct == gemm_t::col_tiles) {
+                ct = 0;
+                if (++rt == gemm_t::row_tiles) {
+                    rt = 0;
+                    mb = 0;
+                    gb = 0;
+                }
+            }
         }
     }
 };
 
 // --- Class 3: Causal Convolution ---
+// Depthwise over the block's inner width E; the line buffer keeps every channel's
+// history, one bank per lane of the beat
+template<typename CONFIG_T>
 class Conv1DBlock {
-    int D;
-    ssm_t line_buffer[2][32];
-    ssm_t weights[3][32];
+public:
+    static const int E = CONFIG_T::e;
+    static const int W = CONFIG_T::e_width;
+    static const int BEATS = CONFIG_T::e_beats;
+
+private:
+    ssm_t line_buffer[2][E];
 
 public:
-    Conv1DBlock(int d) : D(d) {
-        // OPTIMIZATION: Partition all dimensions to allow parallel 1D Conv calculations
-        #pragma HLS ARRAY_PARTITION variable=line_buffer complete dim=0
-        #pragma HLS ARRAY_PARTITION variable=weights complete dim=0
+    Conv1DBlock() {
+        // OPTIMIZATION: Partition to allow parallel 1D Conv calculations on a beat
+        #pragma HLS ARRAY_PARTITION variable=line_buffer complete dim=1
+        #pragma HLS ARRAY_PARTITION variable=line_buffer cyclic factor=W dim=2
 
         for(int r=0; r<2; r++)
-            for(int i=0; i<32; i++) line_buffer[r][i] = 0;
-        for(int k=0; k<3; k++)
-            for(int i=0; i<32; i++) weights[k][i] = 0.33;
+            for(int i=0; i<E; i++) line_buffer[r][i] = 0;
     }
 
     void forward(
-        int L,
-        hls::stream<PixelVec> &in_stream,
-        hls::stream<PixelVec> &out_stream
+        hls::stream<PixelVec<W> > &in_stream,
+        hls::stream<PixelVec<W> > &out_stream
     ) {
-        for(int t=0; t<L; t++) {
+        int b = 0;
+        for(int i=0; i<CONFIG_T::seq_len * BEATS; i++) {
+#pragma HLS PIPELINE II=TOKEN_II
+            PixelVec<W> in_vec = in_stream.read();
+            PixelVec<W> out_vec;
+            #pragma HLS ARRAY_PARTITION variable=in_vec.data cyclic factor=LANES
+            #pragma HLS ARRAY_PARTITION variable=out_vec.data cyclic factor=LANES
 
-            PixelVec in_vec = in_stream.read();
-            PixelVec out_vec;
+            for(int d=0; d<W; d++) {
+#pragma HLS UNROLL
+                const int c = b * W + d;
+                ssm_t conv_val = in_vec.data[d] * CONV1D_WEIGHTS[0][c] +
+                                 line_buffer[0][c] * CONV1D_WEIGHTS[1][c] +
+                                 line_buffer[1][c] * CONV1D_WEIGHTS[2][c];
 
-            for(int d=0; d<32; d++) {
-#pragma HLS PIPELINE II=1
-                if(d < D) {
-                    ssm_t conv_val = in_vec.data[d] * weights[0][d] +
-                                     line_buffer[0][d] * weights[1][d] +
-                                     line_buffer[1][d] * weights[2][d];
-                   
-                    line_buffer[1][d] = line_buffer[0][d];
-                    line_buffer[0][d] = in_vec.data[d];
-
-                    out_vec.data[d] = silu_approx(conv_val);
-                }
+                line_buffer[1][c] = line_buffer[0][c];
+                line_buffer[0][c] = in_vec.data[d];
+
+                out_vec.data[d] = silu_approx(conv_val);
             }
             out_stream.write(out_vec);
+            if (++b == BEATS) b = 0;
         }
     }
 };
 
 // --- Class 4: Output Block ---
+// y = out_proj(ssm * silu(gate)) + residual, out_proj: E -> D. Beats move as in
+// InputProjection; a residual beat is taken with the first row tile of its output beat.
+template<typename CONFIG_T>
 class OutputBlock {
-    int D;
 public:
-    OutputBlock(int d) : D(d) {}
+    static const int D = CONFIG_T::d;
+    static const int E = CONFIG_T::e;
+    static const int DW = CONFIG_T::d_width;
+    static const int DB = CONFIG_T::d_beats;
+    static const int EW = CONFIG_T::e_width;
+    typedef typename CONFIG_T::out_proj_gemm gemm_t;
 
     void forward(
-        int L,
-        hls::stream<PixelVec> &ssm_stream,
-        hls::stream<PixelVec> &gate_stream,
-        hls::stream<PixelVec> &residual_stream,
-        hls::stream<PixelVec> &final_out
+        hls::stream<PixelVec<EW> > &ssm_stream,
+        hls::stream<PixelVec<EW> > &gate_stream,
+        hls::stream<PixelVec<DW> > &residual_stream,
+        hls::stream<PixelVec<DW> > &final_out,
+        hls::stream<ssm_t> &weights
     ) {
-        for(int t=0; t<L; t++) {
-            PixelVec s = ssm_stream.read();
-            PixelVec g = gate_stream.read();
-            PixelVec r = residual_stream.read();
-            PixelVec y;
+        ssm_t w[gemm_t::n_out][gemm_t::n_in];
+        #pragma HLS ARRAY_PARTITION variable=w cyclic factor=gemm_t::pe_rows dim=1
+        #pragma HLS ARRAY_PARTITION variable=w cyclic factor=gemm_t::pe_cols dim=2
+
+        int r = 0, c = 0;
+        for (int i = 0; i < D * E; i++) {
+#pragma HLS PIPELINE II=1
+            w[r][c] = weights.read();
+            if (++c == E) { c = 0; r++; }
+        }
+
+        gemm_accum_t acc[gemm_t::pe_rows];
+        #pragma HLS ARRAY_PARTITION variable=acc complete
+        ssm_t fused[E];
+        PixelVec<DW> res, y;
+        #pragma HLS ARRAY_PARTITION variable=fused cyclic factor=EW
+        #pragma HLS ARRAY_PARTITION variable=res.data cyclic factor=gemm_t::pe_rows
+        #pragma HLS ARRAY_PARTITION variable=y.data cyclic factor=gemm_t::pe_rows
 
-            for(int d=0; d<32; d++) {
+        int rt = 0, ct = 0, ob = 0;
+        for (int i = 0; i < CONFIG_T::seq_len * gemm_t::row_tiles * gemm_t::col_tiles; i++) {
 #pragma HLS PIPELINE II=1
-                if(d < D) {
-                    ssm_t gate_act = silu_approx(g.data[d]);
-                    ssm_t fused = s.data[d] * gate_act;
-                    y.data[d] = fused + r.data[d];
+            if (rt == 0 && (ct * gemm_t::pe_cols) % EW == 0) {
+                PixelVec<EW> s = ssm_stream.read();
+                PixelVec<EW> g = gate_stream.read();
+                for (int d = 0; d < EW; d++) {
+#pragma HLS UNROLL
+                    fused[ct * gemm_t::pe_cols + d] = s.data[d] * silu_approx(g.data[d]);
+                }
+            }
+            if (ct == 0 && (rt * gemm_t::pe_rows) % DW == 0) res = residual_stream.read();
+            gemv_tile_step<gemm_t, ssm_t>(w, fused, acc, rt, ct, D, E);
+            if (ct == gemm_t::col_tiles - 1) {
+                for (int pr = 0; pr < gemm_t::pe_rows; pr++) {
+#pragma HLS UNROLL
+                    int row = rt * gemm_t::pe_rows + pr;
+                    if (row < D) y.data[row % DW] = (ssm_t)(acc[pr] + res.data[row % DW]);
+                }
+                const int last_row = rt * gemm_t::pe_rows + gemm_t::pe_rows - 1;
+                if (ob < DB && last_row >= (ob + 1) * DW - 1) {
+                    final_out.write(y);
+                    ob++;
+                }
+            }
+            if (++ct == gemm_t::col_tiles) {
+                ct = 0;
+                if (++rt == gemm_t::row_tiles) {
+                    rt = 0;
+                    ob = 0;
                 }
             }
-            final_out.write(y);
         }
     }
 };
 // --- Class 5: Splitter (NEW) ---
+template<typename CONFIG_T>
 class Splitter {
 public:
+    static const int W = CONFIG_T::d_width;
+
     void forward(
-        int L,
-        hls::stream<PixelVec> &in_stream,
-        hls::stream<PixelVec> &to_norm,
-        hls::stream<PixelVec> &to_residual
+        hls::stream<PixelVec<W> > &in_stream,
+        hls::stream<PixelVec<W> > &to_norm,
+        hls::stream<PixelVec<W> > &to_residual
     ) {
-        for(int t=0; t<L; t++) {
+        for(int t=0; t<CONFIG_T::seq_len * CONFIG_T::d_beats; t++) {
 #pragma HLS PIPELINE II=1
-            PixelVec p = in_stream.read();
+            PixelVec<W> p = in_stream.read();
             to_norm.write(p);
             to_residual.write(p);
         }
     }
 };
 
-#endif
\ No newline at end of file
+#endif
@@ -2,6 +2,97 @@
 #define PVM_CONFIG_H
 
 #include "types.h"
+#include "skip_planner.h"
+
+// U-Net stack (32x32 input, RGB padded to 8 channels):
+//   enc1 32x32 -> pool -> enc2 16x16 -> pool -> enc3 8x8 -> pool -> enc4 4x4 -> enc5 4x4
+//   -> pool -> bottleneck 2x2 -> up -> dec5 4x4 -> dec4 4x4 -> up -> dec3 8x8
+//   -> up -> dec2 16x16 -> up -> dec1 32x32
+// Each decoder input is its predecessor's (upsampled) output plus the encoder skip
+// of the same resolution, so c_in of a decoder equals c_out of its skip partner.
+// param_size is the layer's share of the weight blob: its Mamba block (mamba_size, shared
+// by the four branches, see vm_weights_size) followed by the c_out x c_in output
+// projection and c_out bias (proj_size).
+// proj_pe_rows x proj_pe_cols MACs run the projection: c_out*c_in/32 cycles per token.
+// token_cycles is the budget per token of the layer's Mamba blocks (vm_config). The
+// full-resolution blocks run at their stages' rate, TOKEN_II cycles per beat of the
+// E-wide stream. A layer with fewer tokens gets the same time per frame, so its
+// projection grids and S6 state lanes shrink to what that rate needs.
+
+const int UNET_FRAME_TOKENS = 32 * 32;
+
+constexpr int unet_token_cycles(int seq_len, int chunk_dim) {
+    return TOKEN_II * (VM_EXPAND * chunk_dim < VEC_WIDTH ? 1 : VM_EXPAND * chunk_dim / VEC_WIDTH) *
+           (UNET_FRAME_TOKENS / seq_len);
+}
+
+struct config_enc1 {
+    static const int H = 32;
+    static const int W = 32;
+    static const int seq_len = H * W;
+    static const int c_in = 8;
+    static const int c_out = 8;
+    static const int chunk_dim = c_in / 4; // 2 channels per Mamba chunk
+    static const int proj_size = c_out * c_in + c_out;
+    static const int mamba_size = vm_weights_size(chunk_dim);
+    static const int param_size = mamba_size + proj_size;
+    static const int token_cycles = unet_token_cycles(seq_len, chunk_dim);
+    static const int proj_pe_rows = 4; // Output-projection MAC grid (gemm.h)
+    static const int proj_pe_cols = 8;
+
+    static constexpr float skip_scale_val = 1.0f;
+};
+
+struct config_enc2 {
+    static const int H = 16;
+    static const int W = 16;
+    static const int seq_len = H * W;
+    static const int c_in = 8;
+    static const int c_out = 16;
+    static const int chunk_dim = c_in / 4; // 2 channels per Mamba chunk
+    static const int proj_size = c_out * c_in + c_out;
+    static const int mamba_size = vm_weights_size(chunk_dim);
+    static const int param_size = mamba_size + proj_size;
+    static const int token_cycles = unet_token_cycles(seq_len, chunk_dim);
+    static const int proj_pe_rows = 4; // Output-projection MAC grid (gemm.h)
+    static const int proj_pe_cols = 8;
+
+    static constexpr float skip_scale_val = 1.0f;
+};
+
+struct config_enc3 {
+    static const int H = 8;
+    static const int W = 8;
+    static const int seq_len = H * W;
+    static const int c_in = 16;
+    static const int c_out = 24;
+    static const int chunk_dim = c_in / 4; // 4 channels per Mamba chunk
+    static const int proj_size = c_out * c_in + c_out;
+    static const int mamba_size = vm_weights_size(chunk_dim);
+    static const int param_size = mamba_size + proj_size;
+    static const int token_cycles = unet_token_cycles(seq_len, chunk_dim);
+    static const int proj_pe_rows = 4; // Output-projection MAC grid (gemm.h)
+    static const int proj_pe_cols = 8;
+
+    static constexpr float skip_scale_val = 1.0f;
+};
+
+struct config_enc4 {
+    static const int H = 4;
+    static const int W = 4;
+    static const int seq_len = H * W;
+    static const int c_in = 24;
+    static const int c_out = 32;
+    static const int chunk_dim = c_in / 4; // 6 channels per Mamba chunk
+    static const int proj_size = c_out * c_in + c_out;
+    static const int mamba_size = vm_weights_size(chunk_dim);
+    static const int param_size = mamba_size + proj_size;
+    static const int token_cycles = unet_token_cycles(seq_len, chunk_dim);
+    static const int proj_pe_rows = 4; // Output-projection MAC grid (gemm.h)
+    static const int proj_pe_cols = 8;
+
+    static constexpr float skip_scale_val = 1.0f;
+};
 
 struct config_enc5{
     static const int H = 4;
@@ -10,22 +101,183 @@ struct config_enc5{
     static const int c_in = 32;
     static const int c_out = 64;
     static const int chunk_dim = c_in / 4; // 8 channels per Mamba chunk
-    
+    static const int proj_size = c_out * c_in + c_out;
+    static const int mamba_size = vm_weights_size(chunk_dim);
+    static const int param_size = mamba_size + proj_size;
+    static const int token_cycles = unet_token_cycles(seq_len, chunk_dim);
+    static const int proj_pe_rows = 4; // Output-projection MAC grid (gemm.h)
+    static const int proj_pe_cols = 8;
+
     static constexpr float skip_scale_val = 1.0f;
 };
 
-struct config_dec2 {
-    static const int H = 1;
-    static const int W = 1;
-    static const int seq_len = H * W; // 1 token
-    
+struct config_bottleneck {
+    static const int H = 2;
+    static const int W = 2;
+    static const int seq_len = H * W;
+    static const int c_in = 64;
+    static const int c_out = 64;
+    static const int chunk_dim = c_in / 4; // 16 channels per Mamba chunk
+    static const int proj_size = c_out * c_in + c_out;
+    static const int mamba_size = vm_weights_size(chunk_dim);
+    static const int param_size = mamba_size + proj_size;
+    static const int token_cycles = unet_token_cycles(seq_len, chunk_dim);
+    static const int proj_pe_rows = 4; // Output-projection MAC grid (gemm.h)
+    static const int proj_pe_cols = 8;
+
+    static constexpr float skip_scale_val = 1.0f;
+};
+
+struct config_dec5 {
+    static const int H = 4;
+    static const int W = 4;
+    static const int seq_len = H * W;
     static const int c_in = 64;
     static const int c_out = 32;
     static const int chunk_dim = c_in / 4; // 16 channels per Mamba chunk
-    
-    static constexpr float skip_scale_val = 1.0f; 
+    static const int proj_size = c_out * c_in + c_out;
+    static const int mamba_size = vm_weights_size(chunk_dim);
+    static const int param_size = mamba_size + proj_size;
+    static const int token_cycles = unet_token_cycles(seq_len, chunk_dim);
+    static const int proj_pe_rows = 4; // Output-projection MAC grid (gemm.h)
+    static const int proj_pe_cols = 8;
+
+    static constexpr float skip_scale_val = 1.0f;
 };
 
+struct config_dec4 {
+    static const int H = 4;
+    static const int W = 4;
+    static const int seq_len = H * W;
+    static const int c_in = 32;
+    static const int c_out = 24;
+    static const int chunk_dim = c_in / 4; // 8 channels per Mamba chunk
+    static const int proj_size = c_out * c_in + c_out;
+    static const int mamba_size = vm_weights_size(chunk_dim);
+    static const int param_size = mamba_size + proj_size;
+    static const int token_cycles = unet_token_cycles(seq_len, chunk_dim);
+    static const int proj_pe_rows = 4; // Output-projection MAC grid (gemm.h)
+    static const int proj_pe_cols = 8;
+
+    static constexpr float skip_scale_val = 1.0f;
+};
+
+struct config_dec3 {
+    static const int H = 8;
+    static const int W = 8;
+    static const int seq_len = H * W;
+    static const int c_in = 24;
+    static const int c_out = 16;
+    static const int chunk_dim = c_in / 4; // 6 channels per Mamba chunk
+    static const int proj_size = c_out * c_in + c_out;
+    static const int mamba_size = vm_weights_size(chunk_dim);
+    static const int param_size = mamba_size + proj_size;
+    static const int token_cycles = unet_token_cycles(seq_len, chunk_dim);
+    static const int proj_pe_rows = 4; // Output-projection MAC grid (gemm.h)
+    static const int proj_pe_cols = 8;
+
+    static constexpr float skip_scale_val = 1.0f;
+};
+
+struct config_dec2 {
+    static const int H = 16;
+    static const int W = 16;
+    static const int seq_len = H * W;
+    static const int c_in = 16;
+    static const int c_out = 8;
+    static const int chunk_dim = c_in / 4; // 4 channels per Mamba chunk
+    static const int proj_size = c_out * c_in + c_out;
+    static const int mamba_size = vm_weights_size(chunk_dim);
+    static const int param_size = mamba_size + proj_size;
+    static const int token_cycles = unet_token_cycles(seq_len, chunk_dim);
+    static const int proj_pe_rows = 4; // Output-projection MAC grid (gemm.h)
+    static const int proj_pe_cols = 8;
+
+    static constexpr float skip_scale_val = 1.0f;
+};
+
+struct config_dec1 {
+    static const int H = 32;
+    static const int W = 32;
+    static const int seq_len = H * W;
+    static const int c_in = 8;
+    static const int c_out = 8;
+    static const int chunk_dim = c_in / 4; // 2 channels per Mamba chunk
+    static const int proj_size = c_out * c_in + c_out;
+    static const int mamba_size = vm_weights_size(chunk_dim);
+    static const int param_size = mamba_size + proj_size;
+    static const int token_cycles = unet_token_cycles(seq_len, chunk_dim);
+    static const int proj_pe_rows = 4; // Output-projection MAC grid (gemm.h)
+    static const int proj_pe_cols = 8;
+
+    static constexpr float skip_scale_val = 1.0f;
+};
+
+// Input normalization of 8-bit pixels (IMAGE_RGBA8, see unet_top.h): image channel c
+// becomes (x / 255 - mean[c]) / std[c]. UNET_PIXEL_NORM 0 keeps x / 255, 1 applies the
+// ImageNet statistics. enc1's channels past UNET_IMG_C are zero.
+#ifndef UNET_PIXEL_NORM
+#define UNET_PIXEL_NORM 0
+#endif
+const int UNET_IMG_C = 3; // R, G, B; alpha is not used
+constexpr float UNET_PIXEL_MEAN[UNET_IMG_C] = {0.485f, 0.456f, 0.406f};
+constexpr float UNET_PIXEL_STD[UNET_IMG_C] = {0.229f, 0.224f, 0.225f};
+static_assert(UNET_IMG_C <= 4 && UNET_IMG_C <= config_enc1::c_in, "image channels must fit the pixel and enc1");
+
+// Per-channel affine map of a byte, x * scale + offset. 28 fraction bits keep the
+// scale exact enough that the result rounds like the float expression.
+typedef ap_fixed<32, 4> pixel_norm_t;
+constexpr double unet_pixel_scale(int c) { return 1.0 / (255.0 * (UNET_PIXEL_NORM ? UNET_PIXEL_STD[c] : 1.0)); }
+constexpr double unet_pixel_offset(int c) { return UNET_PIXEL_NORM ? -UNET_PIXEL_MEAN[c] / UNET_PIXEL_STD[c] : 0.0; }
+
+// Segmentation head on dec1's output (seg_head.h): a 1x1 classifier to UNET_NUM_CLASSES
+// logits. One class is a binary head (logit > 0), more take the argmax.
+#ifndef UNET_NUM_CLASSES
+#define UNET_NUM_CLASSES 2
+#endif
+static_assert(UNET_NUM_CLASSES >= 1 && UNET_NUM_CLASSES <= 16, "UNET_NUM_CLASSES must be 1 .. 16");
+
+struct config_head {
+    static const int H = 32;
+    static const int W = 32;
+    static const int seq_len = H * W;
+    static const int c_in = 8;
+    static const int c_out = UNET_NUM_CLASSES;
+    static const int proj_size = c_out * c_in + c_out;
+    static const int param_size = proj_size;
+    static const int proj_pe_rows = 1; // c_out cycles per token, under the next token's c_in-cycle read
+    static const int proj_pe_cols = 8;
+};
+
+// Total weight blob, layers packed back to back in pipeline order, then the head
+const int UNET_WEIGHTS_SIZE =
+    config_enc1::param_size + config_enc2::param_size + config_enc3::param_size +
+    config_enc4::param_size + config_enc5::param_size + config_bottleneck::param_size +
+    config_dec5::param_size + config_dec4::param_size + config_dec3::param_size +
+    config_dec2::param_size + config_dec1::param_size + config_head::param_size;
+
+// Pipeline stage index of every layer (drives the skip lifetimes)
+enum UnetStage {
+    STAGE_ENC1, STAGE_ENC2, STAGE_ENC3, STAGE_ENC4, STAGE_ENC5, STAGE_BOTTLENECK,
+    STAGE_DEC5, STAGE_DEC4, STAGE_DEC3, STAGE_DEC2, STAGE_DEC1
+};
+
+// Skip tensors: written by an encoder, read by the decoder of matching resolution
+enum UnetSkip { SKIP_ENC1, SKIP_ENC2, SKIP_ENC3, SKIP_ENC4, SKIP_ENC5, UNET_NUM_SKIPS };
+
+constexpr SkipTensor UNET_SKIPS[UNET_NUM_SKIPS] = {
+    skip_tensor<config_enc1>(STAGE_ENC1, STAGE_DEC1),
+    skip_tensor<config_enc2>(STAGE_ENC2, STAGE_DEC2),
+    skip_tensor<config_enc3>(STAGE_ENC3, STAGE_DEC3),
+    skip_tensor<config_enc4>(STAGE_ENC4, STAGE_DEC4),
+    skip_tensor<config_enc5>(STAGE_ENC5, STAGE_DEC5)
+};
+
+constexpr SkipPlan<UNET_NUM_SKIPS> UNET_SKIP_PLAN = plan_skips(UNET_SKIPS);
+
+// DDR spill region the host must provide (at least one word so the port is valid)
+const int UNET_SKIP_SPILL_WORDS = UNET_SKIP_PLAN.spill_words > 0 ? UNET_SKIP_PLAN.spill_words : 1;
+
 
 #endif
 
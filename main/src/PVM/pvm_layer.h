@@ -3,187 +3,525 @@
 
 #include "types.h"
 #include "vision_mamba.h"
+#include "s6_layer.h"
 #include "hls_stream.h"
-#include "hls_math.h"
+#include "gemm.h"
+#include "activations.h"
 
-// Sub-function 1: Read Array, LayerNorm, Split to 4 Streams
+// Wide accumulator of the fused LayerNorm: holds the exact sum of squares of up to 512
+// ssm_t values (15 integer bits per square, 9 more for the sum, 20 fraction bits)
+typedef ap_fixed<46, 26> norm_acc_t;
+
+// Balanced adder tree over the N values of in[]: log2(N) adder levels, no loop-carried
+// accumulator
+template<int N, typename T>
+T pvm_adder_tree(const T in[N]) {
+    #pragma HLS INLINE
+    T level[N];
+    #pragma HLS ARRAY_PARTITION variable=level complete
+    for (int i = 0; i < N; i++) {
+        #pragma HLS UNROLL
+        level[i] = in[i];
+    }
+    for (int w = N; w > 1; w = (w + 1) / 2) {
+        #pragma HLS UNROLL
+        for (int i = 0; i < w / 2; i++) {
+            #pragma HLS UNROLL
+            level[i] = level[2 * i] + level[2 * i + 1];
+        }
+        if (w % 2) level[w / 2] = level[w - 1];
+    }
+    return level[0];
+}
+
+// Single-pass LayerNorm statistics of one token: sum and sum of squares reduced by two
+// adder trees side by side, var = E[x^2] - mean^2. A token wider than the vector word
+// is reduced one beat per cycle, the trees' outputs accumulating across beats. The sums
+// are exact in norm_acc_t, so the only rounding is the final one.
+// Callers partition x cyclic by vec_tile<N>::width.
+template<int N>
+void pvm_layer_norm_stats(const ssm_t x[N], ssm_t &mean, ssm_t &rsqrt) {
+    #pragma HLS INLINE
+    const int W = vec_tile<N>::width;
+    norm_acc_t sum = 0, sum_sq = 0;
+    for (int b = 0; b < vec_tile<N>::beats; b++) {
+        #pragma HLS PIPELINE II=1
+        norm_acc_t xs[W];
+        norm_acc_t sq[W];
+        #pragma HLS ARRAY_PARTITION variable=xs complete
+        #pragma HLS ARRAY_PARTITION variable=sq complete
+        for (int c = 0; c < W; c++) {
+            #pragma HLS UNROLL
+            xs[c] = x[b * W + c];
+            sq[c] = x[b * W + c] * x[b * W + c];
+        }
+        sum += pvm_adder_tree<W, norm_acc_t>(xs);
+        sum_sq += pvm_adder_tree<W, norm_acc_t>(sq);
+    }
+    const norm_acc_t inv_n = norm_acc_t(1.0 / N);
+    norm_acc_t m = sum * inv_n;
+    norm_acc_t var = sum_sq * inv_n - m * m;
+    if (var < 0) var = 0;
+    mean = (ssm_t)m;
+    rsqrt = rsqrt_fixed((rsqrt_in_t)var + rsqrt_in_t(1e-5));
+}
+
+// A layer's Mamba block and the beat layout of its four channel chunks
+template<typename CONFIG_T>
+struct pvm_chunk {
+    typedef vm_config<CONFIG_T::chunk_dim, CONFIG_T::H, CONFIG_T::W, CONFIG_T::token_cycles> mamba_t;
+    static const int width = mamba_t::d_width;
+    static const int beats = mamba_t::d_beats;
+    typedef PixelVec<width> vec_t;
+};
+
+// custom_pvm_layer's skip FIFO. The skip path bypasses the branches, and a branch only
+// emits its first token after the cross-scan reorder has buffered a whole frame, so the
+// FIFO must hold one frame of c_in values.
+template<typename CONFIG_T>
+struct pvm_skip_fifo {
+    static const int depth = CONFIG_T::seq_len * CONFIG_T::c_in;
+};
+
+// Sub-function 1: Read Token Stream, LayerNorm, Split to 4 Streams
+// The raw (pre-norm) channels are forwarded on skip_stream so data_in has a single reader.
+// The skip carries c_in values per token rather than four chunk-wide PixelVecs, because it
+// has to buffer a whole frame.
 template<typename CONFIG_T>
 void pvm_split_and_norm(
-    ssm_t *data_in, 
-    hls::stream<PixelVec> out_streams[4]
+    hls::stream<ssm_t> &data_in, 
+    hls::stream<typename pvm_chunk<CONFIG_T>::vec_t> out_streams[4],
+    hls::stream<ssm_t> &skip_stream
 ) {
     #pragma HLS INLINE off
     const int seq_len = CONFIG_T::seq_len;
     const int c_in = CONFIG_T::c_in;
     const int chunk_dim = CONFIG_T::chunk_dim;
-    const ssm_t inv_c_in = (ssm_t)(1.0f / c_in);
 
-    // REMOVED PIPELINE HERE: Prevents forced unrolling of everything inside
+    const int CW = pvm_chunk<CONFIG_T>::width;
+    const int CB = pvm_chunk<CONFIG_T>::beats;
+
     for (int t = 0; t < seq_len; t++) {
-        
-        ssm_t x[128]; 
-        // FIX: Completely partition to allow parallel operations without port conflicts
-        #pragma HLS ARRAY_PARTITION variable=x complete
-        
-        ssm_t mean = 0;
-        for (int c = 0; c < c_in; c++) {
-            #pragma HLS PIPELINE II=1
-            x[c] = data_in[t * c_in + c];
-            mean += x[c];
-        }
-        mean = mean * inv_c_in;
+        // OPTIMIZATION: Fused single-pass LayerNorm on a token buffer banked by vector
+        // word, so the statistics and the split run one beat per cycle at any c_in
+        ssm_t x[CONFIG_T::c_in];
+        #pragma HLS ARRAY_PARTITION variable=x cyclic factor=vec_tile<CONFIG_T::c_in>::width
 
-        ssm_t var = 0;
         for (int c = 0; c < c_in; c++) {
             #pragma HLS PIPELINE II=1
-            ssm_t diff = x[c] - mean;
-            var += diff * diff;
+            x[c] = data_in.read();
+            skip_stream.write(x[c]);
         }
-        var = var * inv_c_in;
-        
-        float temp_var = (float)(var + (ssm_t)1e-5);
-        ssm_t rsqrt = (ssm_t)(1.0f / hls::sqrt(temp_var));
 
-        // Split into 4 PixelVec streams
-        for (int chunk = 0; chunk < 4; chunk++) {
+        ssm_t mean, rsqrt;
+        pvm_layer_norm_stats<CONFIG_T::c_in>(x, mean, rsqrt);
+
+        // Split into 4 chunk streams, CB beats each
+        int chunk = 0, cb = 0;
+        for (int i = 0; i < 4 * CB; i++) {
             #pragma HLS PIPELINE II=1
-            PixelVec vec;
-            for (int d = 0; d < 32; d++) {
+            typename pvm_chunk<CONFIG_T>::vec_t vec;
+            for (int d = 0; d < CW; d++) {
                 #pragma HLS UNROLL
-                if (d < chunk_dim) {
-                    vec.data[d] = (x[(chunk * chunk_dim) + d] - mean) * rsqrt;
-                } else {
-                    vec.data[d] = 0;
-                }
+                vec.data[d] = (x[chunk * chunk_dim + cb * CW + d] - mean) * rsqrt;
+            }
+            for (int q = 0; q < 4; q++) {
+                #pragma HLS UNROLL
+                if (q == chunk) out_streams[q].write(vec);
             }
-            out_streams[chunk].write(vec);
+            if (++cb == CB) { cb = 0; chunk++; }
         }
     }
 }
 
+// Weight update of one invocation, chosen by the host per frame
+enum WeightLoad {
+    WEIGHTS_RESIDENT = 0, // use the active bank, proj_params is not read
+    WEIGHTS_LOAD = 1,     // fill the active bank before the first token (blocking)
+    WEIGHTS_PREFETCH = 2  // fill the shadow bank behind compute, swap after the frame
+};
+
+// Place one word of the parameter stream (row-major c_out x c_in weights, then the
+// c_out biases) at cursor (row, col) of a bank and advance the cursor
+template<typename CONFIG_T>
+void pvm_store_param(
+    ssm_t w[CONFIG_T::c_out][CONFIG_T::c_in],
+    ssm_t b[CONFIG_T::c_out],
+    int &row, int &col, ssm_t v
+) {
+    #pragma HLS INLINE
+    if (row < CONFIG_T::c_out) w[row][col] = v;
+    else                       b[col] = v;
+    if (row < CONFIG_T::c_out && col == CONFIG_T::c_in - 1) { row++; col = 0; }
+    else                                                    { col++; }
+}
+
 // Sub-function 2: Merge Streams, Skip Connection, LayerNorm, and Project
 template<typename CONFIG_T>
 void pvm_merge_and_project(
-    ssm_t *data_in, 
-    hls::stream<PixelVec> in_streams[4], 
-    ssm_t *data_out,
-    const ssm_t *proj_weights,
-    const ssm_t *proj_bias
+    hls::stream<typename pvm_chunk<CONFIG_T>::vec_t> in_streams[4],
+    hls::stream<ssm_t> &skip_stream,
+    hls::stream<ssm_t> &data_out,
+    hls::stream<ssm_t> &proj_params,
+    int weight_mode
 ) {
     #pragma HLS INLINE off
     const int seq_len = CONFIG_T::seq_len;
     const int c_in = CONFIG_T::c_in;
     const int c_out = CONFIG_T::c_out;
     const int chunk_dim = CONFIG_T::chunk_dim;
-    const ssm_t inv_c_in = (ssm_t)(1.0f / c_in);
     const ssm_t skip_scale = (ssm_t)CONFIG_T::skip_scale_val;
 
-    ssm_t local_proj_w[CONFIG_T::c_out][CONFIG_T::c_in];
-    ssm_t local_proj_b[CONFIG_T::c_out];
-    
-    // FIX: Completely partition dimension 2 so the 64-channel inner loop can read all weights instantly
-    #pragma HLS ARRAY_PARTITION variable=local_proj_w complete dim=2
+    // OPTIMIZATION: Weight-resident, double-buffered. The projection lives on chip across
+    // invocations in two banks. A blocking load refills the active bank. A prefetch fills
+    // the shadow bank one word per projection cycle while this frame computes on the
+    // active bank, and the banks swap once the frame is done. The transfer is fully hidden
+    // whenever seq_len * c_out >= proj_size.
+    static ssm_t local_proj_w[2][CONFIG_T::c_out][CONFIG_T::c_in];
+    static ssm_t local_proj_b[2][CONFIG_T::c_out];
+    static int active = 0;
+    const int shadow = 1 - active;
 
-    for (int out_c = 0; out_c < c_out; out_c++) {
-        local_proj_b[out_c] = proj_bias[out_c];
-        for (int in_c = 0; in_c < c_in; in_c++) {
+    // OPTIMIZATION: One bank per MAC of the projection grid instead of a full partition
+    typedef gemm_config<CONFIG_T::c_out, CONFIG_T::c_in, CONFIG_T::proj_pe_rows, CONFIG_T::proj_pe_cols> proj_gemm;
+    #pragma HLS ARRAY_PARTITION variable=local_proj_w cyclic factor=proj_gemm::pe_rows dim=2
+    #pragma HLS ARRAY_PARTITION variable=local_proj_w cyclic factor=proj_gemm::pe_cols dim=3
+    #pragma HLS ARRAY_PARTITION variable=local_proj_b cyclic factor=proj_gemm::pe_rows dim=2
+
+    if (weight_mode == WEIGHTS_LOAD) {
+        int row = 0, col = 0;
+        for (int i = 0; i < CONFIG_T::proj_size; i++) {
             #pragma HLS PIPELINE II=1
-            local_proj_w[out_c][in_c] = proj_weights[out_c * c_in + in_c];
+            pvm_store_param<CONFIG_T>(local_proj_w[active], local_proj_b[active], row, col, proj_params.read());
         }
     }
 
+    const bool prefetch = (weight_mode == WEIGHTS_PREFETCH);
+    int pf_count = 0, pf_row = 0, pf_col = 0;
+
     // REMOVED PIPELINE HERE: Prevents forced unrolling of the heavy matrix multiplication
     for (int t = 0; t < seq_len; t++) {
 
-        ssm_t merged[128];
-        // FIX: Completely partition
-        #pragma HLS ARRAY_PARTITION variable=merged complete
+        // Banked by vector word: the statistics and the normalize run one beat per cycle
+        const int W = vec_tile<CONFIG_T::c_in>::width;
+        const int CW = pvm_chunk<CONFIG_T>::width;
+        ssm_t merged[CONFIG_T::c_in];
+        #pragma HLS ARRAY_PARTITION variable=merged cyclic factor=W
 
-        // Read 4 streams and apply skip scale
-        for (int chunk = 0; chunk < 4; chunk++) {
+        // Merge the chunk beats, in channel order, with the scaled skip as it streams in
+        typename pvm_chunk<CONFIG_T>::vec_t vec;
+        #pragma HLS ARRAY_PARTITION variable=vec.data complete
+        for (int c = 0; c < c_in; c++) {
             #pragma HLS PIPELINE II=1
-            PixelVec vec = in_streams[chunk].read();
-            for (int d = 0; d < 32; d++) {
-                #pragma HLS UNROLL
-                if (d < chunk_dim) {
-                    int orig_idx = (chunk * chunk_dim) + d;
-                    ssm_t orig_val = data_in[t * c_in + orig_idx];
-                    merged[orig_idx] = vec.data[d] + (skip_scale * orig_val);
+            if (c % CW == 0) {
+                for (int q = 0; q < 4; q++) {
+                    #pragma HLS UNROLL
+                    if (q == c / chunk_dim) vec = in_streams[q].read();
                 }
             }
+            merged[c] = vec.data[c % CW] + (skip_scale * skip_stream.read());
         }
 
-        // Second LayerNorm
-        ssm_t mean = 0;
-        for (int c = 0; c < c_in; c++) {
+        // Second LayerNorm, fused: adder-tree statistics, then normalize in one step
+        ssm_t mean, rsqrt;
+        pvm_layer_norm_stats<CONFIG_T::c_in>(merged, mean, rsqrt);
+
+        ssm_t norm_merged[CONFIG_T::c_in];
+        // W banks also serve the projection's pe_cols-wide reads (pe_cols divides c_in)
+        #pragma HLS ARRAY_PARTITION variable=norm_merged cyclic factor=W
+        for (int b = 0; b < CONFIG_T::c_in / W; b++) {
             #pragma HLS PIPELINE II=1
-            mean += merged[c];
+            for (int c = 0; c < W; c++) {
+                #pragma HLS UNROLL
+                norm_merged[b * W + c] = (merged[b * W + c] - mean) * rsqrt;
+            }
         }
-        mean = mean * inv_c_in;
 
-        ssm_t var = 0;
-        for (int c = 0; c < c_in; c++) {
+        // Linear Projection on the tiled GEMV engine
+        ssm_t proj_out[CONFIG_T::c_out];
+        #pragma HLS ARRAY_PARTITION variable=proj_out cyclic factor=proj_gemm::pe_rows
+        gemv_tiled<proj_gemm, ssm_t>(local_proj_w[active], local_proj_b[active], norm_merged, proj_out);
+
+        for (int out_c = 0; out_c < c_out; out_c++) {
             #pragma HLS PIPELINE II=1
-            ssm_t diff = merged[c] - mean;
-            var += diff * diff;
+            data_out.write(proj_out[out_c]);
+
+            // Shadow-bank prefetch rides along with the projection, never stalling it
+            ssm_t pf_val;
+            if (prefetch && pf_count < CONFIG_T::proj_size && proj_params.read_nb(pf_val)) {
+                pvm_store_param<CONFIG_T>(local_proj_w[shadow], local_proj_b[shadow], pf_row, pf_col, pf_val);
+                pf_count++;
+            }
         }
-        var = var * inv_c_in;
-        
-        float temp_var = (float)(var + (ssm_t)1e-5);
-        ssm_t rsqrt = (ssm_t)(1.0f / hls::sqrt(temp_var));
-
-        ssm_t norm_merged[128];
-        // FIX: Completely partition so the projection loop below has access to all elements
-        #pragma HLS ARRAY_PARTITION variable=norm_merged complete
-        
-        for (int c = 0; c < c_in; c++) {
+    }
+
+    if (prefetch) {
+        // Whatever did not fit behind compute (short frames) is fetched here, then swap
+        for (int i = pf_count; i < CONFIG_T::proj_size; i++) {
             #pragma HLS PIPELINE II=1
-            norm_merged[c] = (merged[c] - mean) * rsqrt;
+            pvm_store_param<CONFIG_T>(local_proj_w[shadow], local_proj_b[shadow], pf_row, pf_col, proj_params.read());
         }
+        active = shadow;
+    }
+}
 
-        // Linear Projection Output
-        // The outer loop handles 1 output channel per clock cycle. The inner loop gets completely unrolled.
-        for (int out_c = 0; out_c < c_out; out_c++) {
+// Resident, double-buffered Mamba weights of one layer (same WeightLoad protocol as the
+// output projection). PVM shares one set of Mamba parameters across the channel chunks,
+// so the blob holds it once and the layer keeps one double bank for all four branches.
+// The active bank is replayed to every branch each frame, one value per cycle written to
+// all four streams; a load fills the bank as it is replayed. A prefetch fills the shadow
+// bank after the replay and swaps the banks for the next frame.
+template<typename CONFIG_T>
+void pvm_mamba_weights(
+    hls::stream<ssm_t> &mamba_params,
+    hls::stream<ssm_t> branch_weights[4],
+    int weight_mode
+) {
+    #pragma HLS INLINE off
+    static ssm_t bank[2][CONFIG_T::mamba_size];
+    static int active = 0;
+
+    for (int i = 0; i < CONFIG_T::mamba_size; i++) {
+        #pragma HLS PIPELINE II=1
+        ssm_t v;
+        if (weight_mode == WEIGHTS_LOAD) {
+            v = mamba_params.read();
+            bank[active][i] = v;
+        } else {
+            v = bank[active][i];
+        }
+        for (int b = 0; b < 4; b++) {
+            #pragma HLS UNROLL
+            branch_weights[b].write(v);
+        }
+    }
+    if (weight_mode == WEIGHTS_PREFETCH) {
+        for (int i = 0; i < CONFIG_T::mamba_size; i++) {
             #pragma HLS PIPELINE II=1
-            ssm_t out_val = local_proj_b[out_c]; 
-            for (int in_c = 0; in_c < c_in; in_c++) {
-                // Since local_proj_w and norm_merged are completely partitioned, 
-                // this 64x unroll synthesizes cleanly and instantly.
-                out_val += norm_merged[in_c] * local_proj_w[out_c][in_c]; 
-            }
-            data_out[t * c_out + out_c] = out_val;
+            bank[1 - active][i] = mamba_params.read();
+        }
+        active = 1 - active;
+    }
+}
+
+// The Mamba block itself as a standalone dataflow process.
+// Keeps the block construction out of the DATAFLOW region so it stays a pure call graph.
+template<typename CONFIG_T>
+void pvm_mamba_block(
+    hls::stream<typename pvm_chunk<CONFIG_T>::vec_t> &in_stream,
+    hls::stream<typename pvm_chunk<CONFIG_T>::vec_t> &out_stream,
+    hls::stream<ssm_t> &block_weights
+) {
+    #pragma HLS INLINE off
+    VisionMambaBlock<typename pvm_chunk<CONFIG_T>::mamba_t> mamba_block;
+    mamba_block.run(in_stream, out_stream, block_weights);
+}
+
+// Cross-scan directions, one per branch: row-major, column-major and their reverses
+enum ScanDir { SCAN_ROW = 0, SCAN_COL = 1, SCAN_ROW_REV = 2, SCAN_COL_REV = 3 };
+
+// Raster index of the token visited at (outer, inner) of a scan in direction DIR.
+// Row scans walk y outer / x inner, column scans x outer / y inner.
+template<typename CONFIG_T, int DIR>
+int pvm_scan_index(int outer, int inner) {
+    #pragma HLS INLINE
+    const bool col = (DIR == SCAN_COL || DIR == SCAN_COL_REV);
+    const bool rev = (DIR == SCAN_ROW_REV || DIR == SCAN_COL_REV);
+    int idx = col ? (inner * CONFIG_T::W + outer) : (outer * CONFIG_T::W + inner);
+    return rev ? (CONFIG_T::seq_len - 1 - idx) : idx;
+}
+
+// Storage class of a one-frame reorder buffer, by depth and word width (one chunk beat
+// of ssm_t values per word). Short frames go to LUTRAM. Deeper frames go to URAM (72 bits x 4K)
+// once it takes at most half as many blocks as BRAM36 (36 bits x 1K), which is the case
+// for the wide chunks of the full-resolution layers. A narrow chunk fits a 32x32 frame
+// in one or two BRAM36 and stays there.
+enum FrameMem { FRAME_LUTRAM = 0, FRAME_BRAM = 1, FRAME_URAM = 2 };
+
+template<int TOKENS, int BITS>
+struct pvm_frame_mem {
+    static const int bram36 = ((BITS + 35) / 36) * ((TOKENS + 1023) / 1024);
+    static const int uram = ((BITS + 71) / 72) * ((TOKENS + 4095) / 4096);
+    static const int value = (TOKENS <= 64) ? FRAME_LUTRAM :
+                             ((TOKENS > 512 && bram36 >= 2 * uram) ? FRAME_URAM : FRAME_BRAM);
+};
+
+// Store a frame in scan order DIR_IN, then emit it in scan order DIR_OUT. A token's
+// beats stay together, in order.
+template<typename CONFIG_T, int DIR_IN, int DIR_OUT>
+void pvm_reorder_frame(
+    hls::stream<typename pvm_chunk<CONFIG_T>::vec_t> &in_stream,
+    hls::stream<typename pvm_chunk<CONFIG_T>::vec_t> &out_stream,
+    typename pvm_chunk<CONFIG_T>::vec_t buf[CONFIG_T::seq_len * pvm_chunk<CONFIG_T>::beats]
+) {
+    #pragma HLS INLINE
+    const int CB = pvm_chunk<CONFIG_T>::beats;
+    const int in_len = (DIR_IN == SCAN_COL || DIR_IN == SCAN_COL_REV) ? CONFIG_T::H : CONFIG_T::W;
+    const int out_len = (DIR_OUT == SCAN_COL || DIR_OUT == SCAN_COL_REV) ? CONFIG_T::H : CONFIG_T::W;
+
+    int outer = 0, inner = 0, b = 0;
+    for (int s = 0; s < CONFIG_T::seq_len * CB; s++) {
+        #pragma HLS PIPELINE II=1
+        buf[pvm_scan_index<CONFIG_T, DIR_IN>(outer, inner) * CB + b] = in_stream.read();
+        if (++b == CB) {
+            b = 0;
+            if (++inner == in_len) { inner = 0; outer++; }
+        }
+    }
+
+    outer = 0; inner = 0; b = 0;
+    for (int s = 0; s < CONFIG_T::seq_len * CB; s++) {
+        #pragma HLS PIPELINE II=1
+        out_stream.write(buf[pvm_scan_index<CONFIG_T, DIR_OUT>(outer, inner) * CB + b]);
+        if (++b == CB) {
+            b = 0;
+            if (++inner == out_len) { inner = 0; outer++; }
         }
     }
 }
 
+// Single-buffer frame reorder, one process per direction change. Storing and replaying
+// in the same process costs 2 cycles per token, which stays ahead of the Mamba block
+// (TOKEN_II cycles per token) whenever TOKEN_II >= 2. That saves the second half of a
+// ping-pong buffer.
+template<typename CONFIG_T, int DIR_IN, int DIR_OUT,
+         int MEM = pvm_frame_mem<CONFIG_T::seq_len * pvm_chunk<CONFIG_T>::beats,
+                                 pvm_chunk<CONFIG_T>::width * ssm_t::width>::value>
+struct pvm_frame_reorder {
+    static void run(hls::stream<typename pvm_chunk<CONFIG_T>::vec_t> &in_stream, hls::stream<typename pvm_chunk<CONFIG_T>::vec_t> &out_stream) {
+        #pragma HLS INLINE off
+        typename pvm_chunk<CONFIG_T>::vec_t buf[CONFIG_T::seq_len * pvm_chunk<CONFIG_T>::beats];
+        #pragma HLS BIND_STORAGE variable=buf type=ram_s2p impl=bram
+        pvm_reorder_frame<CONFIG_T, DIR_IN, DIR_OUT>(in_stream, out_stream, buf);
+    }
+};
+
+template<typename CONFIG_T, int DIR_IN, int DIR_OUT>
+struct pvm_frame_reorder<CONFIG_T, DIR_IN, DIR_OUT, FRAME_LUTRAM> {
+    static void run(hls::stream<typename pvm_chunk<CONFIG_T>::vec_t> &in_stream, hls::stream<typename pvm_chunk<CONFIG_T>::vec_t> &out_stream) {
+        #pragma HLS INLINE off
+        typename pvm_chunk<CONFIG_T>::vec_t buf[CONFIG_T::seq_len * pvm_chunk<CONFIG_T>::beats];
+        #pragma HLS BIND_STORAGE variable=buf type=ram_s2p impl=lutram
+        pvm_reorder_frame<CONFIG_T, DIR_IN, DIR_OUT>(in_stream, out_stream, buf);
+    }
+};
+
+template<typename CONFIG_T, int DIR_IN, int DIR_OUT>
+struct pvm_frame_reorder<CONFIG_T, DIR_IN, DIR_OUT, FRAME_URAM> {
+    static void run(hls::stream<typename pvm_chunk<CONFIG_T>::vec_t> &in_stream, hls::stream<typename pvm_chunk<CONFIG_T>::vec_t> &out_stream) {
+        #pragma HLS INLINE off
+        typename pvm_chunk<CONFIG_T>::vec_t buf[CONFIG_T::seq_len * pvm_chunk<CONFIG_T>::beats];
+        #pragma HLS BIND_STORAGE variable=buf type=ram_s2p impl=uram
+        pvm_reorder_frame<CONFIG_T, DIR_IN, DIR_OUT>(in_stream, out_stream, buf);
+    }
+};
+
+// One cross-scan branch: reorder raster -> DIR, Mamba, reorder DIR -> raster.
+// Every direction (including SCAN_ROW) pays the same two-frame reorder latency,
+// which keeps the four outputs aligned token-for-token at the merge. block_weights is
+// the layer's weight replay for this branch.
+template<typename CONFIG_T, int DIR>
+void pvm_cross_scan_branch(
+    hls::stream<typename pvm_chunk<CONFIG_T>::vec_t> &in_stream,
+    hls::stream<typename pvm_chunk<CONFIG_T>::vec_t> &out_stream,
+    hls::stream<ssm_t> &block_weights
+) {
+    #pragma HLS INLINE off
+    #pragma HLS DATAFLOW
+
+    hls::stream<typename pvm_chunk<CONFIG_T>::vec_t> scan_in("scan_in");
+    hls::stream<typename pvm_chunk<CONFIG_T>::vec_t> scan_out("scan_out");
+    #pragma HLS STREAM variable=scan_in depth=16
+    #pragma HLS STREAM variable=scan_out depth=16
+
+    pvm_frame_reorder<CONFIG_T, SCAN_ROW, DIR>::run(in_stream, scan_in);
+    pvm_mamba_block<CONFIG_T>(scan_in, scan_out, block_weights);
+    pvm_frame_reorder<CONFIG_T, DIR, SCAN_ROW>::run(scan_out, out_stream);
+}
+
 // Top-Level PVM Layer (DATAFLOW Region)
+// Tokens enter and leave as raster-ordered channel streams (c_in / c_out values per
+// token), so layers chain directly. mamba_params / proj_params carry this layer's Mamba
+// and output-projection weights, and are only read when weight_mode (a WeightLoad)
+// asks for a load or a prefetch.
 template<typename CONFIG_T>
 void custom_pvm_layer(
-    ssm_t *data_in,
-    ssm_t *data_out,
-    const ssm_t *proj_weights,
-    const ssm_t *proj_bias
+    hls::stream<ssm_t> &data_in,
+    hls::stream<ssm_t> &data_out,
+    hls::stream<ssm_t> &mamba_params,
+    hls::stream<ssm_t> &proj_params,
+    int weight_mode
 ) {
     #pragma HLS DATAFLOW
 
-    hls::stream<PixelVec> mamba_in[4];
-    hls::stream<PixelVec> mamba_out[4];
+    static_assert(CONFIG_T::seq_len == CONFIG_T::H * CONFIG_T::W, "seq_len must cover the H x W frame");
+    static_assert(CONFIG_T::chunk_dim * 4 == CONFIG_T::c_in, "c_in must split into four Mamba chunks");
+
+    hls::stream<typename pvm_chunk<CONFIG_T>::vec_t> mamba_in[4];
+    hls::stream<typename pvm_chunk<CONFIG_T>::vec_t> mamba_out[4];
+    hls::stream<ssm_t> skip("skip");
+    hls::stream<ssm_t> branch_weights[4];
+    #pragma HLS STREAM variable=branch_weights depth=16
     #pragma HLS STREAM variable=mamba_in depth=16
     #pragma HLS STREAM variable=mamba_out depth=16
+    #pragma HLS STREAM variable=skip depth=pvm_skip_fifo<CONFIG_T>::depth
 
-    pvm_split_and_norm<CONFIG_T>(data_in, mamba_in);
+    pvm_mamba_weights<CONFIG_T>(mamba_params, branch_weights, weight_mode);
+    pvm_split_and_norm<CONFIG_T>(data_in, mamba_in, skip);
 
-    VisionMambaBlock mamba_block_0(CONFIG_T::H, CONFIG_T::W, CONFIG_T::chunk_dim);
-    VisionMambaBlock mamba_block_1(CONFIG_T::H, CONFIG_T::W, CONFIG_T::chunk_dim);
-    VisionMambaBlock mamba_block_2(CONFIG_T::H, CONFIG_T::W, CONFIG_T::chunk_dim);
-    VisionMambaBlock mamba_block_3(CONFIG_T::H, CONFIG_T::W, CONFIG_T::chunk_dim);
+    pvm_cross_scan_branch<CONFIG_T, SCAN_ROW>(mamba_in[0], mamba_out[0], branch_weights[0]);
+    pvm_cross_scan_branch<CONFIG_T, SCAN_COL>(mamba_in[1], mamba_out[1], branch_weights[1]);
+    pvm_cross_scan_branch<CONFIG_T, SCAN_ROW_REV>(mamba_in[2], mamba_out[2], branch_weights[2]);
+    pvm_cross_scan_branch<CONFIG_T, SCAN_COL_REV>(mamba_in[3], mamba_out[3], branch_weights[3]);
 
-    mamba_block_0.run(mamba_in[0], mamba_out[0]);
-    mamba_block_1.run(mamba_in[1], mamba_out[1]);
-    mamba_block_2.run(mamba_in[2], mamba_out[2]);
-    mamba_block_3.run(mamba_in[3], mamba_out[3]);
+    pvm_merge_and_project<CONFIG_T>(mamba_out, skip, data_out, proj_params, weight_mode);
+}
 
-    pvm_merge_and_project<CONFIG_T>(data_in, mamba_out, data_out, proj_weights, proj_bias);
+// On-chip RAM of one custom_pvm_layer, for the stack's budget check (unet_top.cpp):
+// the skip FIFO, the eight reorder frames, the Mamba weight double bank, the output
+// projection's double bank (one bank per MAC) and, per branch, the block's weight
+// working copies (one bank per MAC) and residual / gate delay lines. Stream FIFOs of a
+// few words (SRL) and register-partitioned state are not counted.
+constexpr int pvm_grid_bram18(int pe_rows, int pe_cols, int bank_words) {
+    return pe_rows * pe_cols * ram_bram18(bank_words, ssm_t::width);
 }
 
+template<typename CONFIG_T>
+struct pvm_layer_ram {
+    typedef typename pvm_chunk<CONFIG_T>::mamba_t mamba_t;
+    typedef VisionMambaBlock<mamba_t> block_t;
+    typedef typename mamba_t::in_proj_gemm in_gemm;
+    typedef typename mamba_t::x_proj_gemm x_gemm;
+    typedef typename mamba_t::out_proj_gemm out_gemm;
+    typedef gemm_config<CONFIG_T::c_out, CONFIG_T::c_in, CONFIG_T::proj_pe_rows, CONFIG_T::proj_pe_cols> proj_gemm;
+
+    static const int frame_words = CONFIG_T::seq_len * pvm_chunk<CONFIG_T>::beats;
+    static const int frame_bits = pvm_chunk<CONFIG_T>::width * ssm_t::width;
+    static const int frame_mem = pvm_frame_mem<frame_words, frame_bits>::value;
+    // Chunked-scan delay lines are frame-deep and bound to URAM
+    static const bool delay_uram = (S6_SCAN_CHUNKS > 1);
+    static const int delay_bram18 = delay_uram ? 0 :
+        ram_bram18(block_t::RES_DEPTH, mamba_t::d_width * ssm_t::width) +
+        ram_bram18(block_t::GATE_DEPTH, mamba_t::e_width * ssm_t::width);
+    static const int delay_uram_blocks = delay_uram ?
+        ram_uram(block_t::RES_DEPTH, mamba_t::d_width * ssm_t::width) +
+        ram_uram(block_t::GATE_DEPTH, mamba_t::e_width * ssm_t::width) : 0;
+
+    static const int branch_bram18 =
+        pvm_grid_bram18(in_gemm::pe_rows, in_gemm::pe_cols, in_gemm::row_tiles * in_gemm::col_tiles) +
+        pvm_grid_bram18(x_gemm::pe_rows, x_gemm::pe_cols, x_gemm::row_tiles * x_gemm::col_tiles) +
+        pvm_grid_bram18(out_gemm::pe_rows, out_gemm::pe_cols, out_gemm::row_tiles * out_gemm::col_tiles) +
+        delay_bram18;
+
+    static const int bram18 =
+        ram_bram18(pvm_skip_fifo<CONFIG_T>::depth, ssm_t::width) +
+        ((frame_mem == FRAME_BRAM) ? 8 * ram_bram18(frame_words, frame_bits) : 0) +
+        ram_bram18(2 * CONFIG_T::mamba_size, ssm_t::width) +
+        pvm_grid_bram18(proj_gemm::pe_rows, proj_gemm::pe_cols, 2 * proj_gemm::row_tiles * proj_gemm::col_tiles) +
+        4 * branch_bram18;
+    static const int uram =
+        ((frame_mem == FRAME_URAM) ? 8 * ram_uram(frame_words, frame_bits) : 0) +
+        4 * delay_uram_blocks;
+};
+
 #endif
\ No newline at end of file
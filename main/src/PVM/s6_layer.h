@@ -3,17 +3,616 @@
 
 #include "hls_stream.h"
 #include "types.h"
+#include "gemm.h"
+#include "activations.h"
 
+// State-element parallelism. Each channel's D_STATE-wide state is stored in SL banks
+// (times up to LANES channel banks), and SL elements per channel are advanced per
+// clock. A beat of W channels (types.h) therefore costs ceil(W / LANES) * D_STATE / SL
+// cycles. SL is derived per block from its token budget (vm_config::token_cycles): the
+// fewest state lanes that keep a beat within token_cycles / e_beats. A full-width beat
+// at the default budget gets SL = D_STATE, so the scan keeps pace with the TOKEN_II-per-
+// beat stages around it. A 4-channel beat needs only 4 lanes, and a short-sequence
+// block with a larger budget needs fewer still. S6_STATE_LANES > 0 pins SL instead.
+// Each channel's y = C.h is the sum of its D_STATE products, accumulated across the
+// state lanes in s6_acc_t.
+// The state matrix uses the S4D-real initialization A[n] = -(n + 1), so for N = 1
+// the engine reduces to the single-state recurrence h = exp(-dt) h + dt B x.
+#ifndef S6_STATE_LANES
+#define S6_STATE_LANES 0
+#endif
+static_assert(S6_STATE_LANES == 0 || D_STATE % S6_STATE_LANES == 0, "S6_STATE_LANES must divide SSM_D_STATE");
+
+constexpr int s6_state_lanes(int ch_steps, int beat_cycles) {
+    if (S6_STATE_LANES > 0) return (S6_STATE_LANES < D_STATE) ? S6_STATE_LANES : D_STATE;
+    int sl = 1;
+    while (sl < D_STATE && (D_STATE % sl != 0 || ch_steps * (D_STATE / sl) > beat_cycles)) sl++;
+    return sl;
+}
+
+// Look-ahead depth of the S6 recurrence engine. State h[t] is advanced straight
+// from h[t-K] with K-step coefficients built feed-forward from the last K tokens,
+// so the loop-carried multiply-add gets K * BEAT_II cycles to close instead of
+// one. 0 picks the smallest depth that sustains the block's BEAT_II at 200 MHz.
+// Channels advanced per cycle follow LANES (types.h).
+#ifndef S6_LOOKAHEAD
+#define S6_LOOKAHEAD 0
+#endif
+
+// Chunked associative-scan mode. With S6_SCAN_CHUNKS = P > 1 the frame is split
+// into P chunks of ceil(L/P) tokens. Each chunk's local (decay-product, state) pair is
+// computed in parallel, combined with a log2(P)-level prefix tree, and every chunk is
+// then rescanned in parallel from its exact carry-in. The recurrence phases cost
+// L/P + log2(P) steps instead of L. The frame still streams in and out at one token
+// per BEAT_II without a loop-carried dependency. Only dt, x, B and C are banked
+// (not the expanded per-state terms), and each phase recomputes the discretization.
+// Tolerance: the rescan is the sequential recurrence itself, so the only deviation is
+// the rounding of each carry-in. Outputs match the sequential path within 2 LSB of
+// ssm_t (2^-9) for decays <= 1.
+// P must be a power of two; the chunk banks are sized to the block's own frame.
+// 1 selects the streaming engine.
+#ifndef S6_SCAN_CHUNKS
+#define S6_SCAN_CHUNKS 1
+#endif
+const int S6_P = S6_SCAN_CHUNKS;
+
+// Mamba-2 / SSD (state-space dual) mode. With S6_SSD_CHUNK = Q > 0 the frame is
+// processed in chunks of Q tokens in matrix form:
+//   G   = C B^T                         (Q x Q, shared by all channels)
+//   y_d = (G o L_d) u_d + diag(a_d) C h_d (intra-chunk term plus state contribution)
+//   h_d = a_d(end) h_d + B^T (l_d o u_d)  (inter-chunk state pass)
+// u = dt * x, and L_d[t][s] = exp(-(cum_d[t] - cum_d[s])) for s <= t, where cum_d is
+// the in-chunk prefix sum of dt. As in Mamba-2 the decay is a scalar per channel
+// (A = -1 for every state element) rather than the diagonal A[n] = -(n + 1) of the
+// recurrence engines; for D_STATE = 1 both describe the same model.
+// The engine is one II=1 loop of chunk periods: chunk k is banked while chunk k-1 is
+// computed and chunk k-2 streams out. Compute builds G one row of COLS entries per
+// cycle, then walks the channels LANES at a time, one row of COLS columns per cycle,
+// fusing the three products of every lane (s over Q for the intra-chunk term, n over
+// D_STATE for C h and B^T v). A chunk of a block with e channels therefore costs
+//   max(Q * e_beats, Q * ceil(Q / COLS) + ceil(e / LANES) * Q * ceil(max(Q, D_STATE) / COLS))
+// cycles, and COLS is derived per block as the fewest columns that keep that within
+// Q * token_cycles. At Q = 16 the first and last U-Net stages (4 tokens' worth of
+// budget per token) get COLS = 8 and run at TOKEN_II cycles per token; the deeper
+// stages get 1 or 2 columns. S6_SSD_COLS > 0 pins COLS instead.
+// The engine holds two chunks back, so the block's delay lines are sized for 2Q tokens.
+// Tolerance: products and exponentials are rounded to ssm_t, and the decay is taken
+// from exp of the summed dt instead of a product of per-token decays.
+// Takes precedence over S6_SCAN_CHUNKS.
+#ifndef S6_SSD_CHUNK
+#define S6_SSD_CHUNK 0
+#endif
+#ifndef S6_SSD_COLS
+#define S6_SSD_COLS 0
+#endif
+const int S6_SSD_Q = (S6_SSD_CHUNK > 0) ? S6_SSD_CHUNK : 1;
+static_assert(S6_SSD_CHUNK == 0 || S6_SCAN_CHUNKS == 1, "select either the SSD or the chunked-scan engine");
+
+constexpr int s6_ssd_cols(int q, int groups, int chunk_cycles) {
+    if (S6_SSD_COLS > 0) return S6_SSD_COLS;
+    int span = (q > D_STATE) ? q : D_STATE;
+    int cols = 1;
+    while (cols < span &&
+           q * ((q + cols - 1) / cols) + groups * q * ((span + cols - 1) / cols) > chunk_cycles) cols *= 2;
+    return cols;
+}
+
+// Wide internal type for the look-ahead coefficients (products of decays and inputs)
+typedef ap_fixed<32, 12, AP_RND, AP_SAT> s6_acc_t;
+
+// Selective scan over the block's inner width (CONFIG_T::e channels) for one frame of
+// CONFIG_T::seq_len tokens. Tokens arrive as BEATS words of W channels; every channel
+// keeps its own state, indexed by beat.
+template<typename CONFIG_T>
 class S6Layer {
 public:
-    S6Layer(int d);
+    static const int D = CONFIG_T::e;
+    static const int W = CONFIG_T::e_width;
+    static const int BEATS = CONFIG_T::e_beats;
+    static const int L = CONFIG_T::seq_len;
+    static const int CHUNK_LEN = (L + S6_P - 1) / S6_P; // chunked engine
+
+    // Scan rate (see S6_STATE_LANES): SL state lanes, one beat every BEAT_II cycles
+    static const int CH_STEPS = (W + LANES - 1) / LANES;
+    static const int SL = s6_state_lanes(CH_STEPS, CONFIG_T::token_cycles / BEATS);
+    static const int BEAT_II = CH_STEPS * (D_STATE / SL);
+    static const int K = (S6_LOOKAHEAD > 0) ? S6_LOOKAHEAD : ((BEAT_II >= 2) ? 1 : 2);
+    static_assert(S6_STATE_LANES > 0 || BEAT_II * BEATS <= CONFIG_T::token_cycles,
+                  "S6 scan cannot meet the block's token budget at LANES channels per clock");
+
+    // SSD engine (see S6_SSD_CHUNK): SSD_Q-token chunks, SSD_LANES channels per step
+    static const int SSD_Q = (S6_SSD_Q < L) ? S6_SSD_Q : L;
+    static const int SSD_CHUNKS = (L + SSD_Q - 1) / SSD_Q;
+    static const int SSD_LANES = (LANES < D) ? LANES : D;
+    static const int SSD_GROUPS = (D + SSD_LANES - 1) / SSD_LANES;
+    static const int SSD_BANKS = (W > SSD_LANES) ? W : SSD_LANES; // channel banks
+    static const int SSD_SPAN = (SSD_Q > D_STATE) ? SSD_Q : D_STATE;
+    static const int SSD_COLS = s6_ssd_cols(SSD_Q, SSD_GROUPS, SSD_Q * CONFIG_T::token_cycles);
+    static const int SSD_G_TILES = (SSD_Q + SSD_COLS - 1) / SSD_COLS;
+    static const int SSD_Y_TILES = (SSD_SPAN + SSD_COLS - 1) / SSD_COLS;
+    static const int SSD_CYCLES = SSD_Q * SSD_G_TILES + SSD_GROUPS * SSD_Q * SSD_Y_TILES;
+    static const int SSD_PERIOD = (SSD_CYCLES > SSD_Q * BEATS) ? SSD_CYCLES : SSD_Q * BEATS;
+    static_assert(S6_SSD_CHUNK == 0 || S6_SSD_COLS > 0 || SSD_PERIOD <= SSD_Q * CONFIG_T::token_cycles,
+                  "SSD chunk cannot meet the block's token budget");
+
     void forward(
-        int L,
-        hls::stream<S6Params> &in_stream,
-        hls::stream<PixelVec> &out_stream
+        hls::stream<S6Params<W> > &in_stream,
+        hls::stream<PixelVec<W> > &out_stream
     );
 private:
-    int D;
+    void scan_streaming(
+        hls::stream<S6Params<W> > &in_stream,
+        hls::stream<PixelVec<W> > &out_stream
+    );
+    void scan_chunked(
+        hls::stream<S6Params<W> > &in_stream,
+        hls::stream<PixelVec<W> > &out_stream
+    );
+    void scan_ssd(
+        hls::stream<S6Params<W> > &in_stream,
+        hls::stream<PixelVec<W> > &out_stream
+    );
 };
 
-#endif
\ No newline at end of file
+template<typename CONFIG_T>
+void S6Layer<CONFIG_T>::forward(
+    hls::stream<S6Params<W> > &in_stream,
+    hls::stream<PixelVec<W> > &out_stream
+) {
+    // Compile-time mode select: the unused engine is constant-folded away
+    if (S6_SSD_CHUNK > 0) scan_ssd(in_stream, out_stream);
+    else if (S6_P > 1)    scan_chunked(in_stream, out_stream);
+    else                  scan_streaming(in_stream, out_stream);
+}
+
+template<typename CONFIG_T>
+void S6Layer<CONFIG_T>::scan_streaming(
+    hls::stream<S6Params<W> > &in_stream,
+    hls::stream<PixelVec<W> > &out_stream
+) {
+    // Recurrence engine registers, per channel d and state element n:
+    //   h_hist[k] = h[t-1-k], a_hist[k] / u_hist[k] = discretized terms of token t-k.
+    // Per-call state: a static here would be shared by all four branch instances
+    // and serialize them inside the PVM DATAFLOW region
+    ssm_t h_hist[K][D][D_STATE];
+    s6_acc_t a_hist[K][D][D_STATE];
+    s6_acc_t u_hist[K][D][D_STATE];
+    #pragma HLS ARRAY_PARTITION variable=h_hist complete dim=1
+    #pragma HLS ARRAY_PARTITION variable=a_hist complete dim=1
+    #pragma HLS ARRAY_PARTITION variable=u_hist complete dim=1
+    #pragma HLS ARRAY_PARTITION variable=h_hist cyclic factor=LANES dim=2
+    #pragma HLS ARRAY_PARTITION variable=a_hist cyclic factor=LANES dim=2
+    #pragma HLS ARRAY_PARTITION variable=u_hist cyclic factor=LANES dim=2
+    #pragma HLS ARRAY_PARTITION variable=h_hist cyclic factor=SL dim=3
+    #pragma HLS ARRAY_PARTITION variable=a_hist cyclic factor=SL dim=3
+    #pragma HLS ARRAY_PARTITION variable=u_hist cyclic factor=SL dim=3
+
+    // Reset State at start of frame (a=1, u=0 makes the warm-up window exact)
+    for (int d = 0; d < D; d++) {
+        for (int n = 0; n < D_STATE; n++) {
+            #pragma HLS PIPELINE II=1
+            for (int k = 0; k < K; k++) {
+                #pragma HLS UNROLL
+                h_hist[k][d][n] = 0;
+                a_hist[k][d][n] = 1;
+                u_hist[k][d][n] = 0;
+            }
+        }
+    }
+
+    int b = 0;
+    for (int t = 0; t < L * BEATS; t++) {
+// OPTIMIZATION: One beat every BEAT_II cycles, LANES x SL state updates per clock
+#pragma HLS PIPELINE II=BEAT_II
+        S6Params<W> p = in_stream.read();
+        #pragma HLS ARRAY_PARTITION variable=p.B cyclic factor=SL
+        #pragma HLS ARRAY_PARTITION variable=p.C cyclic factor=SL
+        PixelVec<W> out_vec;
+        #pragma HLS ARRAY_PARTITION variable=out_vec.data cyclic factor=LANES
+
+        for (int l = 0; l < W; l++) {
+#pragma HLS UNROLL
+            const int d = b * W + l;
+            ssm_t dt = p.delta[l];
+            ssm_t x  = p.x[l];
+            s6_acc_t y = 0;
+
+            for (int n = 0; n < D_STATE; n++) {
+#pragma HLS UNROLL
+                // Discretization (feed-forward): A_bar = exp(dt * A[n]) with
+                // A[n] = -(n+1), B_bar*x = dt*B[n]*x
+                ssm_t decay = exp_lut_approx((ssm_t)(dt * (ssm_t)(n + 1)));
+
+                for (int k = K - 1; k > 0; k--) {
+                    a_hist[k][d][n] = a_hist[k-1][d][n];
+                    u_hist[k][d][n] = u_hist[k-1][d][n];
+                }
+                a_hist[0][d][n] = decay;
+                u_hist[0][d][n] = dt * p.B[n] * x;
+
+                // K-step coefficients: A = a_t..a_{t-K+1}, U = sum_j (a_t..a_{t-j+1}) * u_{t-j}
+                s6_acc_t A = 1;
+                s6_acc_t U = 0;
+                for (int j = 0; j < K; j++) {
+                    U = U + A * u_hist[j][d][n];
+                    A = A * a_hist[j][d][n];
+                }
+
+                // SSM Recurrence: h[t] = A*h[t-K] + U (the only loop-carried operation)
+                ssm_t next_state = A * h_hist[K-1][d][n] + U;
+
+                for (int k = K - 1; k > 0; k--) {
+                    h_hist[k][d][n] = h_hist[k-1][d][n];
+                }
+                h_hist[0][d][n] = next_state;
+
+                // Output: y = C . h, accumulated wide across the state elements
+                y += p.C[n] * next_state;
+            }
+            out_vec.data[l] = (ssm_t)y;
+        }
+        out_stream.write(out_vec);
+        if (++b == BEATS) b = 0;
+    }
+}
+
+
+template<typename CONFIG_T>
+void S6Layer<CONFIG_T>::scan_chunked(
+    hls::stream<S6Params<W> > &in_stream,
+    hls::stream<PixelVec<W> > &out_stream
+) {
+    static_assert((S6_P & (S6_P - 1)) == 0, "S6_SCAN_CHUNKS must be a power of two");
+
+    // Frame buffers, one bank per chunk so all chunks are scanned in the same cycle.
+    // Only the token inputs are banked (dt, x per channel, B, C per state element);
+    // the N-wide discretized terms are recomputed in each phase. buf_x is overwritten
+    // in place with y once the rescan has consumed it.
+    ssm_t buf_dt[S6_P][CHUNK_LEN][D];
+    ssm_t buf_x[S6_P][CHUNK_LEN][D];
+    ssm_t buf_B[S6_P][CHUNK_LEN][D_STATE];
+    ssm_t buf_C[S6_P][CHUNK_LEN][D_STATE];
+    #pragma HLS ARRAY_PARTITION variable=buf_dt complete dim=1
+    #pragma HLS ARRAY_PARTITION variable=buf_x complete dim=1
+    #pragma HLS ARRAY_PARTITION variable=buf_B complete dim=1
+    #pragma HLS ARRAY_PARTITION variable=buf_C complete dim=1
+    #pragma HLS ARRAY_PARTITION variable=buf_dt cyclic factor=LANES dim=3
+    #pragma HLS ARRAY_PARTITION variable=buf_x cyclic factor=LANES dim=3
+    #pragma HLS ARRAY_PARTITION variable=buf_B cyclic factor=SL dim=3
+    #pragma HLS ARRAY_PARTITION variable=buf_C cyclic factor=SL dim=3
+
+    // Per-chunk scan pair (A = product of decays, h = state) and carry-in state
+    s6_acc_t chunk_A[S6_P][D][D_STATE];
+    s6_acc_t chunk_h[S6_P][D][D_STATE];
+    ssm_t    carry[S6_P][D][D_STATE];
+    #pragma HLS ARRAY_PARTITION variable=chunk_A complete dim=1
+    #pragma HLS ARRAY_PARTITION variable=chunk_h complete dim=1
+    #pragma HLS ARRAY_PARTITION variable=carry complete dim=1
+    #pragma HLS ARRAY_PARTITION variable=chunk_A cyclic factor=LANES dim=2
+    #pragma HLS ARRAY_PARTITION variable=chunk_h cyclic factor=LANES dim=2
+    #pragma HLS ARRAY_PARTITION variable=carry cyclic factor=LANES dim=2
+    #pragma HLS ARRAY_PARTITION variable=chunk_A cyclic factor=SL dim=3
+    #pragma HLS ARRAY_PARTITION variable=chunk_h cyclic factor=SL dim=3
+    #pragma HLS ARRAY_PARTITION variable=carry cyclic factor=SL dim=3
+
+    const int chunk_len = CHUNK_LEN;
+
+    // Phase 1: bank the frame (feed-forward, no recurrence)
+    int p = 0, i = 0, b = 0;
+    for (int t = 0; t < L * BEATS; t++) {
+#pragma HLS PIPELINE II=TOKEN_II
+        S6Params<W> prm = in_stream.read();
+        for (int l = 0; l < W; l++) {
+#pragma HLS UNROLL
+            buf_dt[p][i][b * W + l] = prm.delta[l];
+            buf_x[p][i][b * W + l]  = prm.x[l];
+        }
+        if (b == 0) {
+            for (int n = 0; n < D_STATE; n++) {
+#pragma HLS UNROLL
+                buf_B[p][i][n] = prm.B[n];
+                buf_C[p][i][n] = prm.C[n];
+            }
+        }
+        if (++b == BEATS) {
+            b = 0;
+            if (++i == chunk_len) { i = 0; p++; }
+        }
+    }
+
+    // Phase 2: local scan of every chunk from a zero state, all chunks in parallel
+    for (int d = 0; d < D; d++) {
+        for (int n = 0; n < D_STATE; n++) {
+#pragma HLS PIPELINE II=1
+            for (int q = 0; q < S6_P; q++) {
+#pragma HLS UNROLL
+                chunk_A[q][d][n] = 1;
+                chunk_h[q][d][n] = 0;
+            }
+        }
+    }
+    int k = 0;
+    b = 0;
+    for (int j = 0; j < chunk_len * BEATS; j++) {
+#pragma HLS PIPELINE II=BEAT_II
+        for (int q = 0; q < S6_P; q++) {
+#pragma HLS UNROLL
+            // Padding slots past L in the last chunk act as the identity (a=1, u=0)
+            if (q * chunk_len + k < L) {
+                for (int l = 0; l < W; l++) {
+#pragma HLS UNROLL
+                    const int d = b * W + l;
+                    ssm_t dt = buf_dt[q][k][d];
+                    for (int n = 0; n < D_STATE; n++) {
+#pragma HLS UNROLL
+                        ssm_t a = exp_lut_approx((ssm_t)(dt * (ssm_t)(n + 1)));
+                        s6_acc_t u = dt * buf_B[q][k][n] * buf_x[q][k][d];
+                        chunk_h[q][d][n] = a * chunk_h[q][d][n] + u;
+                        chunk_A[q][d][n] = a * chunk_A[q][d][n];
+                    }
+                }
+            }
+        }
+        if (++b == BEATS) { b = 0; k++; }
+    }
+
+    // Phase 3: inclusive prefix over chunks (Hillis-Steele, log2(P) levels).
+    // (A1, h1) then (A2, h2) composes to (A2*A1, A2*h1 + h2).
+    for (int d = 0; d < D; d++) {
+        for (int n = 0; n < D_STATE; n++) {
+#pragma HLS PIPELINE II=1
+            for (int step = 1; step < S6_P; step <<= 1) {
+                for (int q = S6_P - 1; q >= step; q--) {
+#pragma HLS UNROLL
+                    chunk_h[q][d][n] = chunk_A[q][d][n] * chunk_h[q-step][d][n] + chunk_h[q][d][n];
+                    chunk_A[q][d][n] = chunk_A[q][d][n] * chunk_A[q-step][d][n];
+                }
+            }
+            carry[0][d][n] = 0;
+            for (int q = 1; q < S6_P; q++) {
+#pragma HLS UNROLL
+                carry[q][d][n] = chunk_h[q-1][d][n];
+            }
+        }
+    }
+
+    // Phase 4: rescan every chunk in parallel from its carry-in; y = C.h replaces x
+    k = 0;
+    b = 0;
+    for (int j = 0; j < chunk_len * BEATS; j++) {
+#pragma HLS PIPELINE II=BEAT_II
+        for (int q = 0; q < S6_P; q++) {
+#pragma HLS UNROLL
+            for (int l = 0; l < W; l++) {
+#pragma HLS UNROLL
+                const int d = b * W + l;
+                ssm_t dt = buf_dt[q][k][d];
+                ssm_t x  = buf_x[q][k][d];
+                s6_acc_t y = 0;
+                for (int n = 0; n < D_STATE; n++) {
+#pragma HLS UNROLL
+                    ssm_t a = exp_lut_approx((ssm_t)(dt * (ssm_t)(n + 1)));
+                    s6_acc_t u = dt * buf_B[q][k][n] * x;
+                    ssm_t next_state = a * carry[q][d][n] + u;
+                    carry[q][d][n] = next_state;
+                    y += buf_C[q][k][n] * next_state;
+                }
+                buf_x[q][k][d] = (ssm_t)y;
+            }
+        }
+        if (++b == BEATS) { b = 0; k++; }
+    }
+
+    // Phase 5: stream the frame back out in token order
+    p = 0; i = 0; b = 0;
+    for (int t = 0; t < L * BEATS; t++) {
+#pragma HLS PIPELINE II=1
+        PixelVec<W> out_vec;
+        for (int l = 0; l < W; l++) {
+#pragma HLS UNROLL
+            out_vec.data[l] = buf_x[p][i][b * W + l];
+        }
+        out_stream.write(out_vec);
+        if (++b == BEATS) {
+            b = 0;
+            if (++i == chunk_len) { i = 0; p++; }
+        }
+    }
+}
+
+
+template<typename CONFIG_T>
+void S6Layer<CONFIG_T>::scan_ssd(
+    hls::stream<S6Params<W> > &in_stream,
+    hls::stream<PixelVec<W> > &out_stream
+) {
+    const int Q = SSD_Q;
+    const int N = D_STATE;
+    const int CS = SSD_COLS;
+
+    // Chunk banks, double-buffered: the read stage fills half k & 1 while compute
+    // reads the other half
+    ssm_t C_c[2][SSD_Q][D_STATE];  // C, token-major
+    ssm_t B_c[2][SSD_Q][D_STATE];  // B, token-major
+    ssm_t u_t[2][D][SSD_Q];        // dt * x, channel-major
+    s6_acc_t cum[2][D][SSD_Q];     // in-chunk prefix sum of dt
+    s6_acc_t cum_end[2][D];        // cum at the chunk's last slot
+    ssm_t y_t[2][D][SSD_Q];        // written by compute, streamed out one period later
+    ssm_t G[SSD_Q][SSD_Q];         // G[t][s] = C_t . B_s of the chunk in compute
+    #pragma HLS ARRAY_PARTITION variable=C_c complete dim=1
+    #pragma HLS ARRAY_PARTITION variable=C_c cyclic factor=CS dim=2
+    #pragma HLS ARRAY_PARTITION variable=C_c complete dim=3
+    #pragma HLS ARRAY_PARTITION variable=B_c complete dim=1
+    #pragma HLS ARRAY_PARTITION variable=B_c cyclic factor=CS dim=2
+    #pragma HLS ARRAY_PARTITION variable=B_c complete dim=3
+    #pragma HLS ARRAY_PARTITION variable=u_t complete dim=1
+    #pragma HLS ARRAY_PARTITION variable=u_t cyclic factor=SSD_BANKS dim=2
+    #pragma HLS ARRAY_PARTITION variable=u_t cyclic factor=CS dim=3
+    #pragma HLS ARRAY_PARTITION variable=cum complete dim=1
+    #pragma HLS ARRAY_PARTITION variable=cum cyclic factor=SSD_BANKS dim=2
+    #pragma HLS ARRAY_PARTITION variable=cum cyclic factor=CS dim=3
+    #pragma HLS ARRAY_PARTITION variable=cum_end complete dim=1
+    #pragma HLS ARRAY_PARTITION variable=cum_end cyclic factor=SSD_BANKS dim=2
+    #pragma HLS ARRAY_PARTITION variable=y_t complete dim=1
+    #pragma HLS ARRAY_PARTITION variable=y_t cyclic factor=SSD_BANKS dim=2
+    #pragma HLS ARRAY_PARTITION variable=G cyclic factor=CS dim=2
+
+    // Inter-chunk state, carried in the wide type, and the state pass of the channel
+    // group in flight
+    s6_acc_t H[D][D_STATE];
+    gemm_accum_t h_acc[SSD_LANES][D_STATE];
+    gemm_accum_t y_diag[SSD_LANES];
+    gemm_accum_t y_state[SSD_LANES];
+    s6_acc_t run[D];
+    #pragma HLS ARRAY_PARTITION variable=H cyclic factor=SSD_LANES dim=1
+    #pragma HLS ARRAY_PARTITION variable=H cyclic factor=CS dim=2
+    #pragma HLS ARRAY_PARTITION variable=h_acc complete dim=0
+    #pragma HLS ARRAY_PARTITION variable=y_diag complete
+    #pragma HLS ARRAY_PARTITION variable=y_state complete
+    #pragma HLS ARRAY_PARTITION variable=run cyclic factor=SSD_BANKS
+    for (int d = 0; d < D; d++) {
+        for (int n = 0; n < D_STATE; n++) {
+            #pragma HLS PIPELINE II=1
+            H[d][n] = 0;
+        }
+    }
+
+    // One period per chunk plus two to drain: the read stage banks chunk k, compute
+    // works on chunk k-1 and the emit stage streams chunk k-2. Padding slots of the
+    // last chunk carry u = 0, B = C = 0 and no dt, so they neither decay nor feed the
+    // state.
+    int k = 0, j = 0;
+    int rt = 0, rb = 0;                     // read: token, beat
+    bool g_phase = true;                    // compute: G rows, then channel groups
+    int ct = 0, ck = 0, cg = 0;             // compute: row, column tile, group
+    int et = 0, eb = 0;                     // emit: token, beat
+    for (int i = 0; i < (SSD_CHUNKS + 2) * SSD_PERIOD; i++) {
+        #pragma HLS PIPELINE II=1
+        // The stages touch opposite halves of the banks, G rows are complete a whole
+        // G pass before they are read, and H is rewritten once per chunk
+        #pragma HLS DEPENDENCE variable=C_c inter false
+        #pragma HLS DEPENDENCE variable=B_c inter false
+        #pragma HLS DEPENDENCE variable=u_t inter false
+        #pragma HLS DEPENDENCE variable=cum inter false
+        #pragma HLS DEPENDENCE variable=cum_end inter false
+        #pragma HLS DEPENDENCE variable=y_t inter false
+        #pragma HLS DEPENDENCE variable=G inter false
+        #pragma HLS DEPENDENCE variable=H inter false
+
+        // Read stage
+        const int r_len = (L - k * Q < Q) ? (L - k * Q) : Q;
+        if (k < SSD_CHUNKS && rt < Q) {
+            const int rh = k & 1;
+            S6Params<W> p;
+            if (rt < r_len) p = in_stream.read();
+            for (int l = 0; l < W; l++) {
+#pragma HLS UNROLL
+                const int d = rb * W + l;
+                ssm_t dt = (rt < r_len) ? p.delta[l] : (ssm_t)0;
+                ssm_t x  = (rt < r_len) ? p.x[l] : (ssm_t)0;
+                s6_acc_t c = ((rt == 0) ? (s6_acc_t)0 : run[d]) + dt;
+                run[d] = c;
+                cum[rh][d][rt] = c;
+                u_t[rh][d][rt] = dt * x;
+                if (rt == Q - 1) cum_end[rh][d] = c;
+            }
+            if (rb == 0) {
+                for (int n = 0; n < D_STATE; n++) {
+#pragma HLS UNROLL
+                    B_c[rh][rt][n] = (rt < r_len) ? p.B[n] : (ssm_t)0;
+                    C_c[rh][rt][n] = (rt < r_len) ? p.C[n] : (ssm_t)0;
+                }
+            }
+            if (++rb == BEATS) { rb = 0; rt++; }
+        }
+
+        // Compute stage
+        if (k >= 1 && k <= SSD_CHUNKS && cg < SSD_GROUPS) {
+            const int ch = (k - 1) & 1;
+            if (g_phase) {
+                // G = C B^T, COLS entries of row ct per cycle, shared by every channel
+                for (int pc = 0; pc < CS; pc++) {
+#pragma HLS UNROLL
+                    const int s = ck * CS + pc;
+                    if (s < Q) {
+                        gemm_accum_t acc = 0;
+                        for (int n = 0; n < D_STATE; n++) {
+#pragma HLS UNROLL
+                            acc += C_c[ch][ct][n] * B_c[ch][s][n];
+                        }
+                        G[ct][s] = (ssm_t)acc;
+                    }
+                }
+                if (++ck == SSD_G_TILES) {
+                    ck = 0;
+                    if (++ct == Q) { ct = 0; g_phase = false; }
+                }
+            } else {
+                // Row ct of every lane: column tile ck of (G o L_d) u_d, of C h_d and
+                // of the state pass B^T (l_d o u_d)
+                for (int l = 0; l < SSD_LANES; l++) {
+#pragma HLS UNROLL
+                    const int d = cg * SSD_LANES + l;
+                    if (d < D) {
+                        const s6_acc_t cum_t = cum[ch][d][ct];
+                        const s6_acc_t cum_q = cum_end[ch][d];
+                        ssm_t to_end = exp_lut_approx((ssm_t)(cum_q - cum_t));
+                        ssm_t v = to_end * u_t[ch][d][ct];
+                        ssm_t chunk_decay = exp_lut_approx((ssm_t)cum_q);
+                        gemm_accum_t diag = (ck == 0) ? (gemm_accum_t)0 : y_diag[l];
+                        gemm_accum_t state = (ck == 0) ? (gemm_accum_t)0 : y_state[l];
+                        for (int pc = 0; pc < CS; pc++) {
+#pragma HLS UNROLL
+                            const int s = ck * CS + pc;
+                            if (s < Q && s <= ct) {
+                                ssm_t decay = exp_lut_approx((ssm_t)(cum_t - cum[ch][d][s]));
+                                ssm_t m = G[ct][s] * decay;
+                                diag += m * u_t[ch][d][s];
+                            }
+                            const int n = s;
+                            if (n < N) {
+                                state += C_c[ch][ct][n] * (ssm_t)H[d][n];
+                                gemm_accum_t h_new = ((ct == 0) ? (gemm_accum_t)0 : h_acc[l][n]) +
+                                                     B_c[ch][ct][n] * v;
+                                h_acc[l][n] = h_new;
+                                if (ct == Q - 1) H[d][n] = chunk_decay * H[d][n] + (s6_acc_t)h_new;
+                            }
+                        }
+                        y_diag[l] = diag;
+                        y_state[l] = state;
+                        if (ck == SSD_Y_TILES - 1) {
+                            ssm_t from_start = exp_lut_approx((ssm_t)cum_t);
+                            y_t[ch][d][ct] = (ssm_t)diag + from_start * (ssm_t)state;
+                        }
+                    }
+                }
+                if (++ck == SSD_Y_TILES) {
+                    ck = 0;
+                    if (++ct == Q) { ct = 0; cg++; }
+                }
+            }
+        }
+
+        // Emit stage, in token order
+        const int e_len = (L - (k - 2) * Q < Q) ? (L - (k - 2) * Q) : Q;
+        if (k >= 2 && et < e_len) {
+            const int eh = k & 1;
+            PixelVec<W> out_vec;
+            for (int l = 0; l < W; l++) {
+#pragma HLS UNROLL
+                out_vec.data[l] = y_t[eh][eb * W + l][et];
+            }
+            out_stream.write(out_vec);
+            if (++eb == BEATS) { eb = 0; et++; }
+        }
+
+        if (++j == SSD_PERIOD) {
+            j = 0; k++;
+            rt = 0; rb = 0;
+            g_phase = true; ct = 0; ck = 0; cg = 0;
+            et = 0; eb = 0;
+        }
+    }
+}
+
+#endif
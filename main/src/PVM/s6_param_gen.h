@@ -3,17 +3,128 @@
 
 #include "hls_stream.h"
 #include "types.h"
+#include "activations.h"
+#include "layers.h"
 
+template<typename CONFIG_T>
 class S6ParamGen {
 public:
-    S6ParamGen(int d);
+    static const int D = CONFIG_T::e;
+    static const int W = CONFIG_T::e_width;
+    static const int BEATS = CONFIG_T::e_beats;
+    typedef typename CONFIG_T::x_proj_gemm gemm_t;
+
     void forward(
-        int L,
-        hls::stream<PixelVec> &in_stream,
-        hls::stream<S6Params> &out_stream
+        hls::stream<PixelVec<W> > &in_stream,
+        hls::stream<S6Params<W> > &out_stream,
+        hls::stream<ssm_t> &weights
     );
-private:
-    int D;
 };
 
-#endif
\ No newline at end of file
+// Selective parameters from learned projections (D is the block's inner width E here):
+//   x_proj:  x -> [dt_low (R), B, C]  (low-rank, tiled on the projection grid)
+//   dt_proj: dt_low -> dt (D) + bias, then softplus
+// B and C are D_STATE-vectors per token, shared by every channel.
+template<typename CONFIG_T>
+void S6ParamGen<CONFIG_T>::forward(
+    hls::stream<PixelVec<W> > &in_stream,
+    hls::stream<S6Params<W> > &out_stream,
+    hls::stream<ssm_t> &weights
+) {
+    const int R = VM_DT_RANK;
+    ssm_t x_w[gemm_t::n_out][gemm_t::n_in];
+    ssm_t dt_w[D][VM_DT_RANK];
+    ssm_t dt_b[D];
+    #pragma HLS ARRAY_PARTITION variable=x_w cyclic factor=gemm_t::pe_rows dim=1
+    #pragma HLS ARRAY_PARTITION variable=x_w cyclic factor=gemm_t::pe_cols dim=2
+    #pragma HLS ARRAY_PARTITION variable=dt_w cyclic factor=W dim=1
+    #pragma HLS ARRAY_PARTITION variable=dt_w complete dim=2
+    #pragma HLS ARRAY_PARTITION variable=dt_b cyclic factor=W
+
+    int r = 0, c = 0;
+    for (int i = 0; i < (R + 2 * D_STATE) * D; i++) {
+        #pragma HLS PIPELINE II=1
+        x_w[r][c] = weights.read();
+        if (++c == D) { c = 0; r++; }
+    }
+    r = 0; c = 0;
+    for (int i = 0; i < D * R; i++) {
+        #pragma HLS PIPELINE II=1
+        dt_w[r][c] = weights.read();
+        if (++c == R) { c = 0; r++; }
+    }
+    for (int i = 0; i < D; i++) {
+        #pragma HLS PIPELINE II=1
+        dt_b[i] = weights.read();
+    }
+
+    // OPTIMIZATION: Token and x_proj tile loops flattened into one II=1 pipeline; the
+    // rank-R dt_proj is unrolled across a beat's channels. The first beat leaves in the
+    // token's last tile cycle, any further beats in the cycles after it.
+    const int X_ROWS = CONFIG_T::x_rows;
+    const int row_tiles = gemm_t::row_tiles;
+    const int col_tiles = gemm_t::col_tiles;
+    gemm_accum_t acc[gemm_t::pe_rows];
+    ssm_t x_dbl[gemm_t::n_out];
+    ssm_t x_in[D];
+    #pragma HLS ARRAY_PARTITION variable=acc complete
+    #pragma HLS ARRAY_PARTITION variable=x_dbl complete
+    #pragma HLS ARRAY_PARTITION variable=x_in cyclic factor=W
+
+    int rt = 0, ct = 0, ob = 0;
+    for (int i = 0; i < CONFIG_T::seq_len * (row_tiles * col_tiles + BEATS - 1); i++) {
+        #pragma HLS PIPELINE II=1
+        if (rt < row_tiles) {
+            if (rt == 0 && (ct * gemm_t::pe_cols) % W == 0) {
+                PixelVec<W> beat = in_stream.read();
+                for (int d = 0; d < W; d++) {
+                    #pragma HLS UNROLL
+                    x_in[ct * gemm_t::pe_cols + d] = beat.data[d];
+                }
+            }
+            gemv_tile_step<gemm_t, ssm_t>(x_w, x_in, acc, rt, ct, X_ROWS, D);
+            if (ct == col_tiles - 1) {
+                for (int pr = 0; pr < gemm_t::pe_rows; pr++) {
+                    #pragma HLS UNROLL
+                    int row = rt * gemm_t::pe_rows + pr;
+                    if (row < X_ROWS) x_dbl[row] = (ssm_t)acc[pr];
+                }
+            }
+            if (++ct == col_tiles) {
+                ct = 0;
+                rt++;
+            }
+        }
+        if (rt == row_tiles) {
+            S6Params<W> params;
+            #pragma HLS ARRAY_PARTITION variable=params.delta cyclic factor=LANES
+            #pragma HLS ARRAY_PARTITION variable=params.B complete
+            #pragma HLS ARRAY_PARTITION variable=params.C complete
+            #pragma HLS ARRAY_PARTITION variable=params.x cyclic factor=LANES
+
+            for (int d = 0; d < W; d++) {
+                #pragma HLS UNROLL
+                const int ch = ob * W + d;
+                gemm_accum_t dt = dt_b[ch];
+                for (int k = 0; k < VM_DT_RANK; k++) {
+                    #pragma HLS UNROLL
+                    dt += (gemm_accum_t)(dt_w[ch][k] * x_dbl[k]);
+                }
+                params.delta[d] = softplus_approx((ssm_t)dt);
+                params.x[d]     = x_in[ch];
+            }
+            for (int n = 0; n < D_STATE; n++) {
+                #pragma HLS UNROLL
+                params.B[n] = x_dbl[R + n];
+                params.C[n] = x_dbl[R + D_STATE + n];
+            }
+            out_stream.write(params);
+            if (++ob == BEATS) {
+                ob = 0;
+                rt = 0;
+            }
+        }
+    }
+}
+
+#endif
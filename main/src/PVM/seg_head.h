@@ -0,0 +1,113 @@
+#ifndef SEG_HEAD_H
+#define SEG_HEAD_H
+
+#include <ap_int.h>
+#include "types.h"
+#include "hls_stream.h"
+#include "gemm.h"
+#include "pvm_layer.h"
+
+// Per-pixel class of the segmentation head
+typedef ap_uint<8> class_id_t;
+
+// Segmentation head: a 1x1 classifier from the CONFIG_T::c_in channels of each token to
+// CONFIG_T::c_out class logits, then the class decision. A single logit is a binary head
+// (class 1 where the logit is positive); more logits take the argmax, the lowest class on
+// ties. The classifier (c_out x c_in weights, c_out biases) follows the layers'
+// WeightLoad protocol on two resident banks, and always drains its parameters so the
+// blob stays in step. With classify false the features pass through unchanged on
+// feat_out and no class ids are produced.
+template<typename CONFIG_T>
+void pvm_seg_head(
+    hls::stream<ssm_t> &feat_in,
+    hls::stream<ssm_t> &params,
+    hls::stream<ssm_t> &feat_out,
+    hls::stream<class_id_t> &class_out,
+    int weight_mode,
+    bool classify
+) {
+    #pragma HLS INLINE off
+    const int c_in = CONFIG_T::c_in;
+    const int c_out = CONFIG_T::c_out;
+
+    static ssm_t local_w[2][CONFIG_T::c_out][CONFIG_T::c_in];
+    static ssm_t local_b[2][CONFIG_T::c_out];
+    static int active = 0;
+
+    typedef gemm_config<CONFIG_T::c_out, CONFIG_T::c_in, CONFIG_T::proj_pe_rows, CONFIG_T::proj_pe_cols> head_gemm;
+    #pragma HLS ARRAY_PARTITION variable=local_w cyclic factor=head_gemm::pe_rows dim=2
+    #pragma HLS ARRAY_PARTITION variable=local_w cyclic factor=head_gemm::pe_cols dim=3
+    #pragma HLS ARRAY_PARTITION variable=local_b cyclic factor=head_gemm::pe_rows dim=2
+
+    if (weight_mode == WEIGHTS_LOAD) {
+        int row = 0, col = 0;
+        for (int i = 0; i < CONFIG_T::proj_size; i++) {
+            #pragma HLS PIPELINE II=1
+            pvm_store_param<CONFIG_T>(local_w[active], local_b[active], row, col, params.read());
+        }
+    }
+
+    // OPTIMIZATION: Token loop flattened into one II=1 pipeline. Token t is read into one
+    // half of x while the classifier runs on token t-1 in the other, so a token costs
+    // SLOT = max(c_in, grid cycles + 1) cycles: the grid, then the class decision.
+    const int tiles = head_gemm::row_tiles * head_gemm::col_tiles;
+    const int SLOT = (c_in > tiles + 1) ? c_in : tiles + 1;
+    ssm_t x[2][CONFIG_T::c_in];
+    #pragma HLS ARRAY_PARTITION variable=x complete dim=1
+    #pragma HLS ARRAY_PARTITION variable=x cyclic factor=head_gemm::pe_cols dim=2
+    typename head_gemm::accum_t acc[head_gemm::pe_rows];
+    #pragma HLS ARRAY_PARTITION variable=acc complete
+    ssm_t logits[CONFIG_T::c_out];
+    #pragma HLS ARRAY_PARTITION variable=logits complete
+
+    int t = 0, k = 0, rt = 0, ct = 0;
+    for (int i = 0; i < (CONFIG_T::seq_len + 1) * SLOT; i++) {
+        #pragma HLS PIPELINE II=1
+        if (t < CONFIG_T::seq_len && k < c_in) {
+            ssm_t v = feat_in.read();
+            x[t & 1][k] = v;
+            if (!classify) feat_out.write(v);
+        }
+
+        if (classify && t > 0) {
+            if (k < tiles) {
+                gemv_tile_step<head_gemm, ssm_t>(local_w[active], x[(t - 1) & 1], acc, rt, ct, c_out, c_in);
+                if (ct == head_gemm::col_tiles - 1) {
+                    for (int pr = 0; pr < head_gemm::pe_rows; pr++) {
+                        #pragma HLS UNROLL
+                        const int r = rt * head_gemm::pe_rows + pr;
+                        if (r < c_out) logits[r] = (ssm_t)(acc[pr] + local_b[active][r]);
+                    }
+                }
+                if (++ct == head_gemm::col_tiles) { ct = 0; rt++; }
+            } else if (k == tiles) {
+                class_id_t cls = 0;
+                if (c_out == 1) {
+                    cls = (logits[0] > 0) ? 1 : 0;
+                } else {
+                    ssm_t best = logits[0];
+                    for (int j = 1; j < c_out; j++) {
+                        #pragma HLS UNROLL
+                        if (logits[j] > best) { best = logits[j]; cls = j; }
+                    }
+                }
+                class_out.write(cls);
+                rt = 0;
+            }
+        }
+
+        if (++k == SLOT) { k = 0; t++; }
+    }
+
+    // The classifier is a few words: a prefetch simply fills the shadow bank after the frame
+    if (weight_mode == WEIGHTS_PREFETCH) {
+        int row = 0, col = 0;
+        for (int i = 0; i < CONFIG_T::proj_size; i++) {
+            #pragma HLS PIPELINE II=1
+            pvm_store_param<CONFIG_T>(local_w[1 - active], local_b[1 - active], row, col, params.read());
+        }
+        active = 1 - active;
+    }
+}
+
+#endif
@@ -0,0 +1,103 @@
+#ifndef SKIP_PLANNER_H
+#define SKIP_PLANNER_H
+
+#include "types.h"
+
+// Compile-time memory planner for U-Net skip tensors.
+// Each skip is described by its size and the pipeline stages that produce and consume
+// it (its lifetime). Tensors are placed greedily, in table order, into BRAM, URAM or a
+// DDR spill region. Every on-chip skip is its own dataflow process with its own buffer,
+// so a memory kind's budget is charged the sum of the tensors placed in it. Only the
+// spill region is shared: spilled tensors get DDR offsets, and tensors with disjoint
+// lifetimes reuse the same words.
+
+// Share of the device reserved for skips (xck26: 144 BRAM36, 64 URAM288)
+#ifndef SKIP_BRAM_BUDGET
+#define SKIP_BRAM_BUDGET 32 // BRAM36 blocks
+#endif
+#ifndef SKIP_URAM_BUDGET
+#define SKIP_URAM_BUDGET 16 // URAM288 blocks
+#endif
+const long SKIP_BRAM_BITS = (long)SKIP_BRAM_BUDGET * 36 * 1024;
+const long SKIP_URAM_BITS = (long)SKIP_URAM_BUDGET * 288 * 1024;
+// Tensors of at least one URAM block prefer URAM, smaller ones prefer BRAM
+const long SKIP_URAM_MIN_BITS = 288L * 1024;
+
+enum SkipMem { SKIP_BRAM = 0, SKIP_URAM = 1, SKIP_DDR = 2 };
+
+struct SkipTensor {
+    int words;     // ssm_t values
+    int def_stage; // stage that writes it
+    int use_stage; // stage that last reads it
+};
+
+// Skip produced by layer PRODUCER_T (its full output tensor)
+template<typename PRODUCER_T>
+constexpr SkipTensor skip_tensor(int def_stage, int use_stage) {
+    return SkipTensor{PRODUCER_T::seq_len * PRODUCER_T::c_out, def_stage, use_stage};
+}
+
+template<int N>
+struct SkipPlan {
+    int mem[N];       // SkipMem of each tensor
+    int offset[N];    // DDR spill offset in ssm_t words (SKIP_DDR only)
+    long bits[3];     // Bits placed per on-chip SkipMem; for SKIP_DDR, the spill region
+    int spill_words;  // Size of the DDR spill region
+};
+
+constexpr long skip_bits(const SkipTensor &t) {
+    return (long)t.words * ssm_t::width;
+}
+
+constexpr bool skip_overlap(const SkipTensor &a, const SkipTensor &b) {
+    return a.def_stage <= b.use_stage && b.def_stage <= a.use_stage;
+}
+
+template<int N>
+constexpr SkipPlan<N> plan_skips(const SkipTensor (&t)[N]) {
+    SkipPlan<N> p{};
+    for (int i = 0; i < N; i++) {
+        bool uram_first = skip_bits(t[i]) >= SKIP_URAM_MIN_BITS;
+        int first = uram_first ? SKIP_URAM : SKIP_BRAM;
+        int second = uram_first ? SKIP_BRAM : SKIP_URAM;
+        long first_budget = uram_first ? SKIP_URAM_BITS : SKIP_BRAM_BITS;
+        long second_budget = uram_first ? SKIP_BRAM_BITS : SKIP_URAM_BITS;
+
+        if (p.bits[first] + skip_bits(t[i]) <= first_budget) {
+            p.mem[i] = first;
+            p.bits[first] += skip_bits(t[i]);
+        } else if (p.bits[second] + skip_bits(t[i]) <= second_budget) {
+            p.mem[i] = second;
+            p.bits[second] += skip_bits(t[i]);
+        } else {
+            // Spill: stack above every earlier spill whose lifetime overlaps
+            p.mem[i] = SKIP_DDR;
+            int offset = 0;
+            for (int j = 0; j < i; j++) {
+                if (p.mem[j] == SKIP_DDR && skip_overlap(t[i], t[j]) &&
+                    p.offset[j] + t[j].words > offset) {
+                    offset = p.offset[j] + t[j].words;
+                }
+            }
+            p.offset[i] = offset;
+            if (offset + t[i].words > p.spill_words) p.spill_words = offset + t[i].words;
+        }
+    }
+
+    p.bits[SKIP_DDR] = (long)p.spill_words * ssm_t::width;
+    return p;
+}
+
+// RAM blocks of the plan's skip buffers in one on-chip kind: BRAM18 blocks for
+// SKIP_BRAM, URAM288 blocks for SKIP_URAM (see ram_bram18 / ram_uram)
+template<int N>
+constexpr int skip_ram_blocks(const SkipTensor (&t)[N], const SkipPlan<N> &p, int mem) {
+    int blocks = 0;
+    for (int i = 0; i < N; i++) {
+        if (p.mem[i] != mem) continue;
+        blocks += (mem == SKIP_BRAM) ? ram_bram18(t[i].words, ssm_t::width) : ram_uram(t[i].words, ssm_t::width);
+    }
+    return blocks;
+}
+
+#endif
@@ -4,8 +4,11 @@
 #include <string>
 #include <cstdlib>
 #include <ctime>
+#include <cmath>
 #include "unet_top.h"
 #include "pvm_config.h"
+#include "activations.h"
+#include "gemm.h"
 
 // --- Helper: Generate Safe Dummy Weights ---
 void fill_with_dummy_weights(std::vector<ssm_t>& arr) {
@@ -16,9 +19,35 @@ void fill_with_dummy_weights(std::vector<ssm_t>& arr) {
     }
 }
 
+// --- Helper: Pack / unpack host tensors for the packed AXI ports (axi_pack.h) ---
+std::vector<axi_word_t> pack_words(const std::vector<ssm_t>& vals) {
+    std::vector<axi_word_t> words(axi_words(vals.size()), (axi_word_t)0);
+    for (size_t i = 0; i < vals.size(); i++) axi_set(words[i / AXI_VALS], i % AXI_VALS, vals[i]);
+    return words;
+}
+
+void unpack_words(const std::vector<axi_word_t>& words, std::vector<ssm_t>& vals) {
+    for (size_t i = 0; i < vals.size(); i++) vals[i] = axi_get(words[i / AXI_VALS], i % AXI_VALS);
+}
+
+// --- Helper: Pack 8-bit RGB pixels (alpha opaque) for the IMAGE_RGBA8 input ---
+std::vector<axi_word_t> pack_pixels(const std::vector<unsigned char>& rgb) {
+    int n = rgb.size() / 3;
+    std::vector<axi_word_t> words(axi_pixel_words(n), (axi_word_t)0);
+    for (int i = 0; i < n; i++) {
+        axi_word_t &w = words[i / AXI_PIXELS];
+        int base = 32 * (i % AXI_PIXELS);
+        for (int c = 0; c < 3; c++) w.range(base + 8 * c + 7, base + 8 * c) = rgb[3 * i + c];
+        w.range(base + 31, base + 24) = 0xFF;
+    }
+    return words;
+}
+
 // --- Helper: Load PPM Image ---
-// Adapts a 3-channel RGB image into the input tensor (padding extra channels with 0)
-bool load_ppm(const char *filename, std::vector<ssm_t> &buffer, int target_H, int target_W, int target_C) {
+// Reads the 8-bit RGB pixels, and adapts them into the input tensor of the IMAGE_FIXED
+// path (scaled by 1/255, extra channels padded with 0)
+bool load_ppm(const char *filename, std::vector<unsigned char> &rgb, std::vector<ssm_t> &buffer,
+              int target_H, int target_W, int target_C) {
     std::ifstream file(filename, std::ios::binary);
     if (!file) {
         std::cerr << "[WARNING] Could not open " << filename << ". Check path!" << std::endl;
@@ -34,7 +63,8 @@ bool load_ppm(const char *filename, std::vector<ssm_t> &buffer, int target_H, in
                   << target_W << "x" << target_H << ")." << std::endl;
     }
 
-    std::vector<unsigned char> temp(target_H * target_W * 3, 0);
+    std::vector<unsigned char> &temp = rgb;
+    temp.assign(target_H * target_W * 3, 0);
     if (type == "P6") {
         file.read(reinterpret_cast<char*>(temp.data()), temp.size());
     } else {
@@ -89,36 +119,163 @@ int main() {
 
     srand(time(NULL));
 
-    // 1. Define dimensions based on your active config
-    int H = config_enc5::H;         
-    int W = config_enc5::W;
-    int seq_len = config_enc5::seq_len; 
-    int c_in = config_enc5::c_in;       
-    int c_out = config_enc5::c_out;     
+    // 0. Fixed-point rsqrt unit against the float path it replaced, over every
+    // positive ssm_t operand
+    {
+        const float lsb = 1.0f / 1024.0f;
+        float max_err = 0.0f;
+        for (int raw = 1; raw < (1 << 17); raw++) {
+            ssm_t v = (ssm_t)(raw * lsb);
+            ssm_t ref = (ssm_t)(1.0f / std::sqrt((float)v));
+            float err = std::fabs((float)rsqrt_fixed((rsqrt_in_t)v) - (float)ref);
+            if (err > max_err) max_err = err;
+        }
+        std::cout << "[INFO] rsqrt unit max error: " << max_err / lsb << " LSB" << std::endl;
+        if (RSQRT_NEWTON > 0 && max_err > lsb) {
+            std::cout << "[FAIL] rsqrt unit exceeds 1 LSB of the float path." << std::endl;
+            return 1;
+        }
+    }
+
+    // 1. Define dimensions based on the first and last layer of the U-Net
+    int H = config_enc1::H;         
+    int W = config_enc1::W;
+    int c_in = config_enc1::c_in;       
+    int c_out = config_dec1::c_out;     
 
-    int image_size = seq_len * c_in;
-    int mask_size = seq_len * c_out;
-    int weights_size = (c_out * c_in) + c_out; 
+    int image_size = config_enc1::seq_len * c_in;
+    int mask_size = config_dec1::seq_len * c_out;
+    int weights_size = UNET_WEIGHTS_SIZE; 
 
     // 2. Allocate memory
     std::vector<ssm_t> image_in(image_size, (ssm_t)0);
     std::vector<ssm_t> mask_out(mask_size, (ssm_t)0);
     std::vector<ssm_t> weights(weights_size, (ssm_t)0);
+    std::vector<ssm_t> skip_spill(UNET_SKIP_SPILL_WORDS, (ssm_t)0);
+    std::vector<unsigned char> rgb;
 
     // 3. Load Real Image & Generate Dummy Weights
     // Make sure to put a small test image at this path, or update the path!
-    if (!load_ppm("C:/RP-FPGA/input.ppm", image_in, H, W, c_in)) {
+    if (!load_ppm("C:/RP-FPGA/input.ppm", rgb, image_in, H, W, c_in)) {
         std::cout << "[FAIL] Exiting due to missing input image." << std::endl;
         return 1;
     }
     
     fill_with_dummy_weights(weights);
+    // The head's classifier at the tail of the blob: unit-scale weights and no bias, so
+    // the class decision follows the (small) features instead of the biases
+    for (int i = 0; i < config_head::param_size; i++) {
+        int k = i / config_head::c_in, c = i % config_head::c_in;
+        weights[weights_size - config_head::param_size + i] =
+            (k < config_head::c_out) ? (ssm_t)(((k * 3 + c * 5) % 7 - 3) * 0.25f) : (ssm_t)0;
+    }
+
+    // The ports move packed words; the image goes in as its 8-bit pixels
+    std::vector<axi_word_t> image_words = pack_pixels(rgb);
+    std::vector<axi_word_t> weight_words = pack_words(weights);
+    std::vector<axi_word_t> mask_words(axi_words(mask_size), (axi_word_t)0);
 
     // 4. Execute the Hardware IP Core
     std::cout << "[INFO] Executing hardware module unet_pvm_top..." << std::endl;
-    unet_pvm_top(image_in.data(), mask_out.data(), weights.data());
+    unet_pvm_top(image_words.data(), mask_words.data(), weight_words.data(), skip_spill.data(), 1, 1, IMAGE_RGBA8, OUTPUT_FEATURES);
+    unpack_words(mask_words, mask_out);
     std::cout << "[INFO] Hardware execution complete." << std::endl;
 
+    // 4b. Weight cache: a second frame with the same version must not touch the blob
+    std::vector<axi_word_t> cached_out(mask_words.size(), (axi_word_t)0);
+    std::vector<axi_word_t> stale_weights(weight_words.size(), (axi_word_t)0);
+    unet_pvm_top(image_words.data(), cached_out.data(), stale_weights.data(), skip_spill.data(), 1, 0, IMAGE_RGBA8, OUTPUT_FEATURES);
+    for (size_t i = 0; i < mask_words.size(); i++) {
+        if (cached_out[i] != mask_words[i]) {
+            std::cout << "[FAIL] Resident-weight run differs at " << i << std::endl;
+            return 1;
+        }
+    }
+    std::cout << "[INFO] Resident-weight invocation matches." << std::endl;
+
+    // 4c. Prefetch: a second, distinct blob is staged while the frame still runs bit for
+    // bit on the old weights; the next frame (its port holding zeros) must run on the new
+    // blob exactly as a blocking load of it does
+    std::vector<ssm_t> next_weights(weights_size, (ssm_t)0);
+    fill_with_dummy_weights(next_weights);
+    for (int i = weights_size - config_head::param_size; i < weights_size; i++) next_weights[i] = weights[i];
+    std::vector<axi_word_t> next_words = pack_words(next_weights);
+    std::vector<axi_word_t> prefetch_out(mask_words.size(), (axi_word_t)0);
+    std::vector<axi_word_t> swapped_out(mask_words.size(), (axi_word_t)0);
+    std::vector<axi_word_t> loaded_out(mask_words.size(), (axi_word_t)0);
+    unet_pvm_top(image_words.data(), prefetch_out.data(), next_words.data(), skip_spill.data(), 2, 2, IMAGE_RGBA8, OUTPUT_FEATURES);
+    unet_pvm_top(image_words.data(), swapped_out.data(), stale_weights.data(), skip_spill.data(), 2, 0, IMAGE_RGBA8, OUTPUT_FEATURES);
+    unet_pvm_top(image_words.data(), loaded_out.data(), next_words.data(), skip_spill.data(), 2, 1, IMAGE_RGBA8, OUTPUT_FEATURES);
+    bool swapped = false;
+    for (size_t i = 0; i < mask_words.size(); i++) {
+        if (prefetch_out[i] != mask_words[i]) {
+            std::cout << "[FAIL] Prefetching frame left the old weights at " << i << std::endl;
+            return 1;
+        }
+        if (swapped_out[i] != loaded_out[i]) {
+            std::cout << "[FAIL] Prefetched weights mismatch at " << i << std::endl;
+            return 1;
+        }
+        if (swapped_out[i] != mask_words[i]) swapped = true;
+    }
+    if (!swapped) {
+        std::cout << "[FAIL] Bank swap left the old weights in use." << std::endl;
+        return 1;
+    }
+    std::cout << "[INFO] Prefetch and bank swap match." << std::endl;
+
+    // Restore the original blob for the output check below
+    unet_pvm_top(image_words.data(), mask_words.data(), weight_words.data(), skip_spill.data(), 1, 1, IMAGE_RGBA8, OUTPUT_FEATURES);
+    unpack_words(mask_words, mask_out);
+
+    // 4d. The on-chip pixel normalization must match the host-converted tensor
+    // (IMAGE_FIXED input); with UNET_PIXEL_NORM the host path no longer applies
+    if (!UNET_PIXEL_NORM) {
+        std::vector<axi_word_t> tensor_words = pack_words(image_in);
+        std::vector<axi_word_t> fixed_out(mask_words.size(), (axi_word_t)0);
+        unet_pvm_top(tensor_words.data(), fixed_out.data(), weight_words.data(), skip_spill.data(), 1, 0, IMAGE_FIXED, OUTPUT_FEATURES);
+        for (size_t i = 0; i < mask_words.size(); i++) {
+            if (fixed_out[i] != mask_words[i]) {
+                std::cout << "[FAIL] 8-bit pixel input differs from the fixed-point tensor at " << i << std::endl;
+                return 1;
+            }
+        }
+        std::cout << "[INFO] 8-bit pixel input matches the fixed-point tensor." << std::endl;
+    }
+
+    // 4e. Segmentation head: class ids (one byte per pixel) and the bit mask must match
+    // the 1x1 classifier applied on the host to the features above, with the head's
+    // parameters at the tail of the blob
+    {
+        const int n_cls = config_head::c_out, n_ch = config_head::c_in, n_px = config_head::seq_len;
+        const ssm_t *head_w = &weights[weights_size - config_head::param_size];
+        const ssm_t *head_b = head_w + n_cls * n_ch;
+        std::vector<axi_word_t> class_words(mask_words.size(), (axi_word_t)0);
+        std::vector<axi_word_t> bit_words(mask_words.size(), (axi_word_t)0);
+        unet_pvm_top(image_words.data(), class_words.data(), weight_words.data(), skip_spill.data(), 1, 0, IMAGE_RGBA8, OUTPUT_CLASS_ID);
+        unet_pvm_top(image_words.data(), bit_words.data(), weight_words.data(), skip_spill.data(), 1, 0, IMAGE_RGBA8, OUTPUT_MASK);
+        int foreground = 0;
+        for (int px = 0; px < n_px; px++) {
+            int expected = 0;
+            ssm_t best = 0;
+            for (int k = 0; k < n_cls; k++) {
+                gemm_accum_t acc = 0;
+                for (int c = 0; c < n_ch; c++) acc += (gemm_accum_t)(head_w[k * n_ch + c] * mask_out[px * n_ch + c]);
+                ssm_t logit = (ssm_t)(acc + head_b[k]);
+                if (n_cls == 1) expected = (logit > 0) ? 1 : 0;
+                else if (k == 0 || logit > best) { best = logit; expected = k; }
+            }
+            int cls = class_words[px / (PVM_AXI_BITS / 8)].range(8 * (px % (PVM_AXI_BITS / 8)) + 7, 8 * (px % (PVM_AXI_BITS / 8))).to_int();
+            int bit = bit_words[px / PVM_AXI_BITS][px % PVM_AXI_BITS] ? 1 : 0;
+            if (cls != expected || bit != (expected != 0)) {
+                std::cout << "[FAIL] Segmentation head mismatch at pixel " << px << std::endl;
+                return 1;
+            }
+            foreground += bit;
+        }
+        std::cout << "[INFO] Segmentation head matches (" << foreground << " / " << n_px << " pixels foreground)." << std::endl;
+    }
+
     // 5. Save the output
     save_ppm("output_feature_map.ppm", mask_out, H, W, c_out);
 
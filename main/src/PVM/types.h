@@ -5,15 +5,96 @@
 
 typedef ap_fixed<18, 8, AP_RND, AP_SAT> ssm_t;
 
+// Vector word: at most VEC_WIDTH channels travel in one stream word. A token wider than
+// that is carried as several beats, consecutive words holding its channels in order
+// (beat b holds channels b * VEC_WIDTH ..). Stages keep per-channel state indexed by
+// beat, and reductions accumulate across the beats of a token, so wider layers reuse
+// the same datapath instead of widening it.
+#ifndef PVM_VEC_WIDTH
+#define PVM_VEC_WIDTH 32
+#endif
+const int VEC_WIDTH = PVM_VEC_WIDTH;
+
+// Vector lanes: channels processed per clock by the per-token stages.
+// Must divide VEC_WIDTH. VEC_WIDTH is full width (one beat per cycle), 1 is fully serial.
+#ifndef PVM_LANES
+#define PVM_LANES 8
+#endif
+const int LANES = PVM_LANES;
+const int TOKEN_II = VEC_WIDTH / LANES; // Cycles per beat in each per-token stage
+static_assert(VEC_WIDTH % LANES == 0, "PVM_LANES must divide PVM_VEC_WIDTH");
+
+// RAM blocks of one buffer bank, for the on-chip budget checks. A bank of at most 64
+// words maps to LUTRAM or registers. Deeper banks take BRAM18 blocks (1K x 18, 512 x 36
+// or 2K x 9, whichever needs fewest) or URAM288 blocks (4K x 72).
+constexpr int ram_bram18(int words, int bits) {
+    if (words <= 64) return 0;
+    int n18 = ((bits + 17) / 18) * ((words + 1023) / 1024);
+    int n36 = ((bits + 35) / 36) * ((words + 511) / 512);
+    int n9 = ((bits + 8) / 9) * ((words + 2047) / 2048);
+    int n = (n18 < n36) ? n18 : n36;
+    return (n < n9) ? n : n9;
+}
+
+constexpr int ram_uram(int words, int bits) {
+    return ((bits + 71) / 72) * ((words + 4095) / 4096);
+}
+
+// Beat layout of an N-channel token: one word of N channels when N fits the vector
+// word, otherwise N / VEC_WIDTH full words
+template<int N>
+struct vec_tile {
+    static const int width = (N < VEC_WIDTH) ? N : VEC_WIDTH;
+    static const int beats = N / width;
+    static_assert(N % width == 0, "channel count must be a multiple of PVM_VEC_WIDTH");
+};
+
+// One stream word of N channels. N is the stage's real beat width (vec_tile), so stream
+// words, FIFOs and per-channel loops carry no padding.
+template<int N>
 struct PixelVec {
-    ssm_t data[32]; 
+    ssm_t data[N];
 };
 
+// SSM state width N: every channel carries an N-wide state, and B / C are N-vectors
+// shared by all channels of a token
+#ifndef SSM_D_STATE
+#define SSM_D_STATE 16
+#endif
+const int D_STATE = SSM_D_STATE;
+
+// Mamba block geometry. The inner width is E = MAMBA_EXPAND * D, at most VM_MAX_E (the
+// width of the constant norm / conv weight tables). dt is produced by a rank-MAMBA_DT_RANK
+// projection.
+#ifndef MAMBA_EXPAND
+#define MAMBA_EXPAND 2
+#endif
+#ifndef MAMBA_DT_RANK
+#define MAMBA_DT_RANK 1
+#endif
+const int VM_EXPAND = MAMBA_EXPAND;
+const int VM_DT_RANK = MAMBA_DT_RANK;
+const int VM_MAX_E = 256;
+
+// Weight-blob layout of one Mamba block (D model channels, E = expand * D, R = dt rank,
+// N = D_STATE):
+//   in_proj  [2E][D]   main rows, then gate rows
+//   x_proj   [R+2N][E] dt rows, then the N rows of B, then the N rows of C
+//   dt_proj  [E][R]    followed by its [E] bias
+//   out_proj [D][E]
+constexpr int vm_weights_size(int d) {
+    return 2 * (VM_EXPAND * d) * d + (VM_DT_RANK + 2 * D_STATE) * (VM_EXPAND * d) +
+           (VM_EXPAND * d) * VM_DT_RANK + (VM_EXPAND * d) + d * (VM_EXPAND * d);
+}
+
+// S6 inputs of one beat of an N-channel word; B and C belong to the whole token and
+// repeat on each of its beats
+template<int N>
 struct S6Params {
-    ssm_t delta[32];
-    ssm_t B[32];
-    ssm_t C[32];
-    ssm_t x[32];
+    ssm_t delta[N];
+    ssm_t B[D_STATE];
+    ssm_t C[D_STATE];
+    ssm_t x[N];
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,179 @@
+#ifndef UNET_STAGES_H
+#define UNET_STAGES_H
+
+#include "types.h"
+#include "hls_stream.h"
+#include "skip_planner.h"
+
+// Glue stages between chained PVM layers. All tensors are raster-ordered token
+// streams with C channel values per token, matching custom_pvm_layer's ports.
+
+// Move one layer's section of the (unpacked) weight blob onto its parameter streams: the
+// Mamba block weights first (the branches take them before their first token), then the
+// output projection (c_out x c_in weights, c_out biases), which a prefetch drains
+// behind compute
+template<typename CONFIG_T>
+void pvm_load_params(hls::stream<ssm_t> &src, hls::stream<ssm_t> &mamba_params, hls::stream<ssm_t> &proj_params) {
+    #pragma HLS INLINE off
+    for (int i = 0; i < CONFIG_T::mamba_size; i++) {
+        #pragma HLS PIPELINE II=1
+        mamba_params.write(src.read());
+    }
+    for (int i = 0; i < CONFIG_T::proj_size; i++) {
+        #pragma HLS PIPELINE II=1
+        proj_params.write(src.read());
+    }
+}
+
+// Duplicate an encoder output: one copy continues down the U-Net, one is the skip
+template<typename CONFIG_T>
+void pvm_tee(
+    hls::stream<ssm_t> &in_stream,
+    hls::stream<ssm_t> &out_next,
+    hls::stream<ssm_t> &out_skip
+) {
+    #pragma HLS INLINE off
+    for (int i = 0; i < CONFIG_T::seq_len * CONFIG_T::c_out; i++) {
+        #pragma HLS PIPELINE II=1
+        ssm_t v = in_stream.read();
+        out_next.write(v);
+        out_skip.write(v);
+    }
+}
+
+// Skip-tensor storage, placed by the skip planner. A skip is only consumed after its
+// producer has emitted the whole tensor, because every layer's cross-scan buffers a
+// full frame. So one process can absorb the tensor and replay it without a ping-pong
+// copy. The primary template is the BRAM placement.
+// Only the DDR placement touches the spill port. The on-chip run() is inlined into the
+// caller's dataflow region and calls a store() process that takes no spill pointer, so
+// the port is wired to the spilling instances alone.
+template<typename PRODUCER_T, int MEM, int SPILL_OFFSET>
+struct pvm_skip_buffer {
+    static void run(hls::stream<ssm_t> &in_stream, hls::stream<ssm_t> &out_stream, ssm_t *) {
+        #pragma HLS INLINE
+        store(in_stream, out_stream);
+    }
+
+    static void store(hls::stream<ssm_t> &in_stream, hls::stream<ssm_t> &out_stream) {
+        #pragma HLS INLINE off
+        const int N = PRODUCER_T::seq_len * PRODUCER_T::c_out;
+        ssm_t buf[N];
+        #pragma HLS BIND_STORAGE variable=buf type=ram_s2p impl=bram
+        for (int i = 0; i < N; i++) {
+            #pragma HLS PIPELINE II=1
+            buf[i] = in_stream.read();
+        }
+        for (int i = 0; i < N; i++) {
+            #pragma HLS PIPELINE II=1
+            out_stream.write(buf[i]);
+        }
+    }
+};
+
+template<typename PRODUCER_T, int SPILL_OFFSET>
+struct pvm_skip_buffer<PRODUCER_T, SKIP_URAM, SPILL_OFFSET> {
+    static void run(hls::stream<ssm_t> &in_stream, hls::stream<ssm_t> &out_stream, ssm_t *) {
+        #pragma HLS INLINE
+        store(in_stream, out_stream);
+    }
+
+    static void store(hls::stream<ssm_t> &in_stream, hls::stream<ssm_t> &out_stream) {
+        #pragma HLS INLINE off
+        const int N = PRODUCER_T::seq_len * PRODUCER_T::c_out;
+        ssm_t buf[N];
+        #pragma HLS BIND_STORAGE variable=buf type=ram_s2p impl=uram
+        for (int i = 0; i < N; i++) {
+            #pragma HLS PIPELINE II=1
+            buf[i] = in_stream.read();
+        }
+        for (int i = 0; i < N; i++) {
+            #pragma HLS PIPELINE II=1
+            out_stream.write(buf[i]);
+        }
+    }
+};
+
+// DDR spill: round-trips the tensor through its planned region of the spill port
+template<typename PRODUCER_T, int SPILL_OFFSET>
+struct pvm_skip_buffer<PRODUCER_T, SKIP_DDR, SPILL_OFFSET> {
+    static void run(hls::stream<ssm_t> &in_stream, hls::stream<ssm_t> &out_stream, ssm_t *spill) {
+        #pragma HLS INLINE off
+        const int N = PRODUCER_T::seq_len * PRODUCER_T::c_out;
+        for (int i = 0; i < N; i++) {
+            #pragma HLS PIPELINE II=1
+            spill[SPILL_OFFSET + i] = in_stream.read();
+        }
+        for (int i = 0; i < N; i++) {
+            #pragma HLS PIPELINE II=1
+            out_stream.write(spill[SPILL_OFFSET + i]);
+        }
+    }
+};
+
+// 2x2 max-pool of layer CONFIG_T's output (H x W x c_out -> H/2 x W/2 x c_out).
+// One half-width line buffer holds the running maxima of the current output row.
+template<typename CONFIG_T>
+void pvm_downsample(
+    hls::stream<ssm_t> &in_stream,
+    hls::stream<ssm_t> &out_stream
+) {
+    #pragma HLS INLINE off
+    const int C = CONFIG_T::c_out;
+    ssm_t line[CONFIG_T::W / 2][C];
+
+    for (int y = 0; y < CONFIG_T::H; y++) {
+        for (int x = 0; x < CONFIG_T::W; x++) {
+            for (int c = 0; c < C; c++) {
+                #pragma HLS PIPELINE II=1
+                ssm_t v = in_stream.read();
+                ssm_t &m = line[x / 2][c];
+                // First pixel of the window initializes, the rest take the max
+                if ((y % 2 == 0) && (x % 2 == 0)) m = v;
+                else if (v > m) m = v;
+                // Bottom-right pixel closes the window
+                if ((y % 2 == 1) && (x % 2 == 1)) out_stream.write(m);
+            }
+        }
+    }
+}
+
+// Nearest-neighbour 2x upsample of the previous layer's output (H/2 x W/2 x c_in)
+// fused with the encoder skip add, producing decoder CONFIG_T's input (H x W x c_in).
+// Each low-res row is buffered on its first use and replayed for the second output row.
+template<typename CONFIG_T>
+void pvm_upsample_add(
+    hls::stream<ssm_t> &low_stream,
+    hls::stream<ssm_t> &skip_stream,
+    hls::stream<ssm_t> &out_stream
+) {
+    #pragma HLS INLINE off
+    const int C = CONFIG_T::c_in;
+    ssm_t row[CONFIG_T::W / 2][C];
+
+    for (int y = 0; y < CONFIG_T::H; y++) {
+        for (int x = 0; x < CONFIG_T::W; x++) {
+            for (int c = 0; c < C; c++) {
+                #pragma HLS PIPELINE II=1
+                if ((y % 2 == 0) && (x % 2 == 0)) row[x / 2][c] = low_stream.read();
+                out_stream.write(row[x / 2][c] + skip_stream.read());
+            }
+        }
+    }
+}
+
+// Same-resolution skip add (decoder input = previous decoder output + encoder skip)
+template<typename CONFIG_T>
+void pvm_skip_add(
+    hls::stream<ssm_t> &in_stream,
+    hls::stream<ssm_t> &skip_stream,
+    hls::stream<ssm_t> &out_stream
+) {
+    #pragma HLS INLINE off
+    for (int i = 0; i < CONFIG_T::seq_len * CONFIG_T::c_in; i++) {
+        #pragma HLS PIPELINE II=1
+        out_stream.write(in_stream.read() + skip_stream.read());
+    }
+}
+
+#endif
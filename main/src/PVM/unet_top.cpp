@@ -1,48 +1,365 @@
 #include "unet_top.h"
 #include "pvm_config.h"
 #include "pvm_layer.h"
+#include "unet_stages.h"
+#include "seg_head.h"
 
-void unet_pvm_top(
-    ssm_t *image_in, 
-    ssm_t *mask_out, 
-    ssm_t *weights
-) {
-    // FIX: Optimized depths for 4x4 resolution
-    // image_in: 4*4 (H*W) * 32 (c_in) = 512
-    // mask_out: 4*4 (H*W) * 64 (c_out) = 1024
-    // weights: 64*32 (weights) + 64 (bias) = 2112
-    #pragma HLS INTERFACE m_axi port=image_in bundle=gmem0 depth=512
-    #pragma HLS INTERFACE m_axi port=mask_out bundle=gmem1 depth=1024
-    #pragma HLS INTERFACE m_axi port=weights bundle=gmem2 depth=2112
-    #pragma HLS INTERFACE s_axilite port=return
+// Channel bookkeeping of the stack: every stage must consume what the previous produced
+static_assert(config_enc2::c_in == config_enc1::c_out, "enc1 -> enc2 channel mismatch");
+static_assert(config_enc3::c_in == config_enc2::c_out, "enc2 -> enc3 channel mismatch");
+static_assert(config_enc4::c_in == config_enc3::c_out, "enc3 -> enc4 channel mismatch");
+static_assert(config_enc5::c_in == config_enc4::c_out, "enc4 -> enc5 channel mismatch");
+static_assert(config_bottleneck::c_in == config_enc5::c_out, "enc5 -> bottleneck channel mismatch");
+static_assert(config_dec5::c_in == config_bottleneck::c_out && config_dec5::c_in == config_enc5::c_out, "dec5 skip mismatch");
+static_assert(config_dec4::c_in == config_dec5::c_out && config_dec4::c_in == config_enc4::c_out, "dec4 skip mismatch");
+static_assert(config_dec3::c_in == config_dec4::c_out && config_dec3::c_in == config_enc3::c_out, "dec3 skip mismatch");
+static_assert(config_dec2::c_in == config_dec3::c_out && config_dec2::c_in == config_enc2::c_out, "dec2 skip mismatch");
+static_assert(config_dec1::c_in == config_dec2::c_out && config_dec1::c_in == config_enc1::c_out, "dec1 skip mismatch");
 
-    // Static buffers sized based on config_enc5 (H=4, W=4, c_in=32, c_out=64)
-    static ssm_t enc4_out[config_enc5::seq_len * config_enc5::c_in];
-    static ssm_t enc5_out[config_enc5::seq_len * config_enc5::c_out];
-    #pragma HLS ARRAY_PARTITION variable=enc5_out cyclic factor=4 dim=1
+// The Mamba token budgets (pvm_config.h) assume the full-resolution layers are the longest
+static_assert(config_enc1::seq_len == UNET_FRAME_TOKENS && config_dec1::seq_len == UNET_FRAME_TOKENS,
+              "UNET_FRAME_TOKENS must be the full-resolution frame");
 
-    // Map weights and calculate the bias offset
-    const int weight_offset = config_enc5::c_out * config_enc5::c_in;
-    const ssm_t *enc5_proj_w = weights; 
-    const ssm_t *enc5_proj_b = weights + weight_offset;
+const int UNET_IN_SIZE = config_enc1::seq_len * config_enc1::c_in;
+const int UNET_OUT_SIZE = config_dec1::seq_len * config_dec1::c_out;
+static_assert(config_head::c_in == config_dec1::c_out && config_head::seq_len == config_dec1::seq_len, "head shape mismatch");
 
-    // Copy input to internal buffer with pipeline to aid burst inference
-    for(int i=0; i < config_enc5::seq_len * config_enc5::c_in; i++) {
-        #pragma HLS PIPELINE II=1
-        enc4_out[i] = image_in[i];
+// Packed port sizes, in AXI words
+const int UNET_IN_WORDS = axi_words(UNET_IN_SIZE);
+const int UNET_OUT_WORDS = axi_words(UNET_OUT_SIZE);
+const int UNET_WEIGHT_WORDS = axi_words(UNET_WEIGHTS_SIZE);
+const int UNET_IN_PIXEL_WORDS = axi_pixel_words(config_enc1::seq_len);
+const int UNET_OUT_CLASS_WORDS = (config_head::seq_len * 8 + PVM_AXI_BITS - 1) / PVM_AXI_BITS;
+const int UNET_OUT_MASK_WORDS = (config_head::seq_len + PVM_AXI_BITS - 1) / PVM_AXI_BITS;
+// Each port's depth is the word count of its widest format, the packed tensor
+static_assert(UNET_IN_PIXEL_WORDS <= UNET_IN_WORDS, "image_in depth below must cover the pixel format");
+static_assert(UNET_OUT_CLASS_WORDS <= UNET_OUT_WORDS && UNET_OUT_MASK_WORDS <= UNET_OUT_WORDS,
+              "mask_out depth below must cover the head formats");
+
+// Skip placement must stay within the reserved on-chip budgets
+static_assert(UNET_SKIP_PLAN.bits[SKIP_BRAM] <= SKIP_BRAM_BITS, "skip BRAM plan over budget");
+static_assert(UNET_SKIP_PLAN.bits[SKIP_URAM] <= SKIP_URAM_BITS, "skip URAM plan over budget");
+
+// On-chip RAM of the whole stack against the device (xck26: 144 BRAM36 = 288 BRAM18,
+// 64 URAM288): every layer's buffers and weight banks (pvm_layer_ram), the skip buffers,
+// and the pool / upsample line buffers. The head and the stream FIFOs stay in LUTRAM
+// and registers.
+#ifndef UNET_DEVICE_BRAM18
+#define UNET_DEVICE_BRAM18 288
+#endif
+#ifndef UNET_DEVICE_URAM
+#define UNET_DEVICE_URAM 64
+#endif
+template<typename CONFIG_T, int C>
+constexpr int unet_line_bram18() { return ram_bram18(CONFIG_T::W / 2 * C, SSM_BITS); }
+
+const int UNET_RAM_BRAM18 =
+    pvm_layer_ram<config_enc1>::bram18 + pvm_layer_ram<config_enc2>::bram18 +
+    pvm_layer_ram<config_enc3>::bram18 + pvm_layer_ram<config_enc4>::bram18 +
+    pvm_layer_ram<config_enc5>::bram18 + pvm_layer_ram<config_bottleneck>::bram18 +
+    pvm_layer_ram<config_dec5>::bram18 + pvm_layer_ram<config_dec4>::bram18 +
+    pvm_layer_ram<config_dec3>::bram18 + pvm_layer_ram<config_dec2>::bram18 +
+    pvm_layer_ram<config_dec1>::bram18 +
+    skip_ram_blocks(UNET_SKIPS, UNET_SKIP_PLAN, SKIP_BRAM) +
+    unet_line_bram18<config_enc1, config_enc1::c_out>() + unet_line_bram18<config_enc2, config_enc2::c_out>() +
+    unet_line_bram18<config_enc3, config_enc3::c_out>() + unet_line_bram18<config_enc5, config_enc5::c_out>() +
+    unet_line_bram18<config_dec5, config_dec5::c_in>() + unet_line_bram18<config_dec3, config_dec3::c_in>() +
+    unet_line_bram18<config_dec2, config_dec2::c_in>() + unet_line_bram18<config_dec1, config_dec1::c_in>();
+const int UNET_RAM_URAM =
+    pvm_layer_ram<config_enc1>::uram + pvm_layer_ram<config_enc2>::uram +
+    pvm_layer_ram<config_enc3>::uram + pvm_layer_ram<config_enc4>::uram +
+    pvm_layer_ram<config_enc5>::uram + pvm_layer_ram<config_bottleneck>::uram +
+    pvm_layer_ram<config_dec5>::uram + pvm_layer_ram<config_dec4>::uram +
+    pvm_layer_ram<config_dec3>::uram + pvm_layer_ram<config_dec2>::uram +
+    pvm_layer_ram<config_dec1>::uram +
+    skip_ram_blocks(UNET_SKIPS, UNET_SKIP_PLAN, SKIP_URAM);
+static_assert(UNET_RAM_BRAM18 <= UNET_DEVICE_BRAM18, "stack's on-chip buffers exceed the device BRAM");
+static_assert(UNET_RAM_URAM <= UNET_DEVICE_URAM, "stack's on-chip buffers exceed the device URAM");
+
+// Weight fetch: burst the packed blob off the weights port, then unpack it to one value
+// per cycle. Nothing is fetched for WEIGHTS_RESIDENT: the layers then run on their
+// resident weights.
+void unet_fetch_weights(const axi_word_t *weights, hls::stream<axi_word_t> &words, int weight_mode) {
+    #pragma HLS INLINE off
+    if (weight_mode == WEIGHTS_RESIDENT) return;
+    axi_read_words<UNET_WEIGHT_WORDS>(weights, words);
+}
+
+void unet_unpack_weights(hls::stream<axi_word_t> &words, hls::stream<ssm_t> &blob, int weight_mode) {
+    #pragma HLS INLINE off
+    if (weight_mode == WEIGHTS_RESIDENT) return;
+    axi_unpack<UNET_WEIGHTS_SIZE>(words, blob);
+}
+
+// Image fetch: the packed enc1 tensor, or a quarter or less as many words of 8-bit pixels
+void unet_read_image(const axi_word_t *image, hls::stream<axi_word_t> &words, int image_format) {
+    #pragma HLS INLINE off
+    if (image_format == IMAGE_RGBA8) axi_read_words<UNET_IN_PIXEL_WORDS>(image, words);
+    else                             axi_read_words<UNET_IN_WORDS>(image, words);
+}
+
+// Expand the image words into enc1's input stream, one value per cycle. 8-bit pixels are
+// normalized per channel and padded with zero channels up to enc1's c_in.
+void unet_unpack_image(hls::stream<axi_word_t> &words, hls::stream<ssm_t> &out_stream, int image_format) {
+    #pragma HLS INLINE off
+    if (image_format != IMAGE_RGBA8) {
+        axi_unpack<UNET_IN_SIZE>(words, out_stream);
+        return;
     }
+    static_assert(UNET_IMG_C == 3, "pixel normalization table below is out of date");
+    const pixel_norm_t scale[UNET_IMG_C] = {unet_pixel_scale(0), unet_pixel_scale(1), unet_pixel_scale(2)};
+    const pixel_norm_t offset[UNET_IMG_C] = {unet_pixel_offset(0), unet_pixel_offset(1), unet_pixel_offset(2)};
 
-    // Execute PVMLayer Enc 5 [cite: 7]
-    custom_pvm_layer<config_enc5>(
-        enc4_out, 
-        enc5_out, 
-        enc5_proj_w, 
-        enc5_proj_b
-    );
+    axi_word_t word = 0;
+    int p = 0, c = 0;
+    for (int i = 0; i < UNET_IN_SIZE; i++) {
+        #pragma HLS PIPELINE II=1
+        if (p == 0 && c == 0) word = words.read();
+        if (c < UNET_IMG_C) out_stream.write((ssm_t)(axi_get_byte(word, p, c) * scale[c] + offset[c]));
+        else                out_stream.write((ssm_t)0);
+        if (++c == config_enc1::c_in) {
+            c = 0;
+            if (++p == AXI_PIXELS) p = 0;
+        }
+    }
+}
 
-    // Copy to output
-    for(int i=0; i < config_enc5::seq_len * config_enc5::c_out; i++) {
+// Deal the unpacked blob, in pipeline order, onto every layer's Mamba and projection
+// streams and the head's. Each layer drains its streams before its first token. For a
+// prefetch the layers drain their streams behind compute, so the fetch of layer N+1
+// overlaps layer N's frame.
+void unet_load_weights(hls::stream<ssm_t> &blob, hls::stream<ssm_t> mamba[11], hls::stream<ssm_t> params[11],
+                       hls::stream<ssm_t> &head_params, int weight_mode) {
+    #pragma HLS INLINE off
+    if (weight_mode == WEIGHTS_RESIDENT) return;
+    pvm_load_params<config_enc1>(blob, mamba[0], params[0]);
+    pvm_load_params<config_enc2>(blob, mamba[1], params[1]);
+    pvm_load_params<config_enc3>(blob, mamba[2], params[2]);
+    pvm_load_params<config_enc4>(blob, mamba[3], params[3]);
+    pvm_load_params<config_enc5>(blob, mamba[4], params[4]);
+    pvm_load_params<config_bottleneck>(blob, mamba[5], params[5]);
+    pvm_load_params<config_dec5>(blob, mamba[6], params[6]);
+    pvm_load_params<config_dec4>(blob, mamba[7], params[7]);
+    pvm_load_params<config_dec3>(blob, mamba[8], params[8]);
+    pvm_load_params<config_dec2>(blob, mamba[9], params[9]);
+    pvm_load_params<config_dec1>(blob, mamba[10], params[10]);
+    for (int i = 0; i < config_head::param_size; i++) {
         #pragma HLS PIPELINE II=1
-        mask_out[i] = enc5_out[i];
+        head_params.write(blob.read());
     }
-}
\ No newline at end of file
+}
+
+// Pack what mask_out carries this frame: the features, or the head's classes as bytes
+// or as a bit mask
+void unet_pack_output(hls::stream<ssm_t> &features, hls::stream<class_id_t> &classes,
+                      hls::stream<axi_word_t> &words, int output_format) {
+    #pragma HLS INLINE off
+    if (output_format == OUTPUT_CLASS_ID)  axi_pack_bytes<config_head::seq_len>(classes, words);
+    else if (output_format == OUTPUT_MASK) axi_pack_bits<config_head::seq_len>(classes, words);
+    else                                   axi_pack<UNET_OUT_SIZE>(features, words);
+}
+
+void unet_write_output(hls::stream<axi_word_t> &words, axi_word_t *frame, int output_format) {
+    #pragma HLS INLINE off
+    if (output_format == OUTPUT_CLASS_ID)  axi_write_words<UNET_OUT_CLASS_WORDS>(words, frame);
+    else if (output_format == OUTPUT_MASK) axi_write_words<UNET_OUT_MASK_WORDS>(words, frame);
+    else                                   axi_write_words<UNET_OUT_WORDS>(words, frame);
+}
+
+// Whole encoder/decoder stack as one DATAFLOW region: every layer, resample and skip
+// stage is a concurrent process and activations move between them as streams. The
+// frame ports are the top-level m_axi ports themselves: the reader bursts tokens into
+// enc1 as they arrive and the writer drains dec1's tokens as they leave, so no frame is
+// staged on chip and the first token reaches enc1 after the reader's burst latency.
+void unet_pvm_pipeline(const axi_word_t *frame_in, axi_word_t *frame_out, const axi_word_t *weights, ssm_t *skip_spill,
+                       int weight_mode, int image_format, int output_format) {
+    #pragma HLS DATAFLOW
+
+    hls::stream<ssm_t> layer_mamba[11];
+    hls::stream<ssm_t> layer_params[11];
+    #pragma HLS STREAM variable=layer_mamba depth=16
+    #pragma HLS STREAM variable=layer_params depth=16
+
+    // Packed words on either side of the pack / unpack stages
+    hls::stream<axi_word_t> s_in_words("s_in_words"), s_out_words("s_out_words"), s_weight_words("s_weight_words");
+    hls::stream<ssm_t> s_weights("s_weights"), s_head_params("s_head_params");
+    hls::stream<ssm_t> s_features("s_features");
+    hls::stream<class_id_t> s_classes("s_classes");
+    #pragma HLS STREAM variable=s_in_words depth=4
+    #pragma HLS STREAM variable=s_out_words depth=4
+    #pragma HLS STREAM variable=s_weight_words depth=4
+    #pragma HLS STREAM variable=s_weights depth=16
+    #pragma HLS STREAM variable=s_head_params depth=16
+    #pragma HLS STREAM variable=s_features depth=16
+    #pragma HLS STREAM variable=s_classes depth=16
+
+    // Layer-to-layer activations
+    hls::stream<ssm_t> s_in("s_in"), s_out("s_out");
+    hls::stream<ssm_t> s_enc1("s_enc1"), s_enc1_next("s_enc1_next"), s_enc2_in("s_enc2_in");
+    hls::stream<ssm_t> s_enc2("s_enc2"), s_enc2_next("s_enc2_next"), s_enc3_in("s_enc3_in");
+    hls::stream<ssm_t> s_enc3("s_enc3"), s_enc3_next("s_enc3_next"), s_enc4_in("s_enc4_in");
+    hls::stream<ssm_t> s_enc4("s_enc4"), s_enc5_in("s_enc5_in");
+    hls::stream<ssm_t> s_enc5("s_enc5"), s_enc5_next("s_enc5_next"), s_bott_in("s_bott_in");
+    hls::stream<ssm_t> s_bott("s_bott"), s_dec5_in("s_dec5_in");
+    hls::stream<ssm_t> s_dec5("s_dec5"), s_dec4_in("s_dec4_in");
+    hls::stream<ssm_t> s_dec4("s_dec4"), s_dec3_in("s_dec3_in");
+    hls::stream<ssm_t> s_dec3("s_dec3"), s_dec2_in("s_dec2_in");
+    hls::stream<ssm_t> s_dec2("s_dec2"), s_dec1_in("s_dec1_in");
+    #pragma HLS STREAM variable=s_in depth=16
+    #pragma HLS STREAM variable=s_out depth=16
+    #pragma HLS STREAM variable=s_enc1 depth=16
+    #pragma HLS STREAM variable=s_enc1_next depth=16
+    #pragma HLS STREAM variable=s_enc2_in depth=16
+    #pragma HLS STREAM variable=s_enc2 depth=16
+    #pragma HLS STREAM variable=s_enc2_next depth=16
+    #pragma HLS STREAM variable=s_enc3_in depth=16
+    #pragma HLS STREAM variable=s_enc3 depth=16
+    #pragma HLS STREAM variable=s_enc3_next depth=16
+    #pragma HLS STREAM variable=s_enc4_in depth=16
+    #pragma HLS STREAM variable=s_enc4 depth=16
+    #pragma HLS STREAM variable=s_enc5_in depth=16
+    #pragma HLS STREAM variable=s_enc5 depth=16
+    #pragma HLS STREAM variable=s_enc5_next depth=16
+    #pragma HLS STREAM variable=s_bott_in depth=16
+    #pragma HLS STREAM variable=s_bott depth=16
+    #pragma HLS STREAM variable=s_dec5_in depth=16
+    #pragma HLS STREAM variable=s_dec5 depth=16
+    #pragma HLS STREAM variable=s_dec4_in depth=16
+    #pragma HLS STREAM variable=s_dec4 depth=16
+    #pragma HLS STREAM variable=s_dec3_in depth=16
+    #pragma HLS STREAM variable=s_dec3 depth=16
+    #pragma HLS STREAM variable=s_dec2_in depth=16
+    #pragma HLS STREAM variable=s_dec2 depth=16
+    #pragma HLS STREAM variable=s_dec1_in depth=16
+
+    // Encoder skips: tee -> planned skip buffer -> decoder. The tensors live in the
+    // buffers (see UNET_SKIP_PLAN), so the streams around them stay shallow.
+    hls::stream<ssm_t> skip_enc1("skip_enc1"), skip_enc2("skip_enc2"), skip_enc3("skip_enc3");
+    hls::stream<ssm_t> skip_enc4("skip_enc4"), skip_enc5("skip_enc5");
+    hls::stream<ssm_t> skip_enc1_out("skip_enc1_out"), skip_enc2_out("skip_enc2_out");
+    hls::stream<ssm_t> skip_enc3_out("skip_enc3_out"), skip_enc4_out("skip_enc4_out");
+    hls::stream<ssm_t> skip_enc5_out("skip_enc5_out");
+    #pragma HLS STREAM variable=skip_enc1 depth=16
+    #pragma HLS STREAM variable=skip_enc2 depth=16
+    #pragma HLS STREAM variable=skip_enc3 depth=16
+    #pragma HLS STREAM variable=skip_enc4 depth=16
+    #pragma HLS STREAM variable=skip_enc5 depth=16
+    #pragma HLS STREAM variable=skip_enc1_out depth=16
+    #pragma HLS STREAM variable=skip_enc2_out depth=16
+    #pragma HLS STREAM variable=skip_enc3_out depth=16
+    #pragma HLS STREAM variable=skip_enc4_out depth=16
+    #pragma HLS STREAM variable=skip_enc5_out depth=16
+
+    unet_fetch_weights(weights, s_weight_words, weight_mode);
+    unet_unpack_weights(s_weight_words, s_weights, weight_mode);
+    unet_load_weights(s_weights, layer_mamba, layer_params, s_head_params, weight_mode);
+    unet_read_image(frame_in, s_in_words, image_format);
+    unet_unpack_image(s_in_words, s_in, image_format);
+
+    // Encoder
+    custom_pvm_layer<config_enc1>(s_in, s_enc1, layer_mamba[0], layer_params[0], weight_mode);
+    pvm_tee<config_enc1>(s_enc1, s_enc1_next, skip_enc1);
+    pvm_skip_buffer<config_enc1, UNET_SKIP_PLAN.mem[SKIP_ENC1], UNET_SKIP_PLAN.offset[SKIP_ENC1]>::run(
+        skip_enc1, skip_enc1_out, skip_spill);
+    pvm_downsample<config_enc1>(s_enc1_next, s_enc2_in);
+
+    custom_pvm_layer<config_enc2>(s_enc2_in, s_enc2, layer_mamba[1], layer_params[1], weight_mode);
+    pvm_tee<config_enc2>(s_enc2, s_enc2_next, skip_enc2);
+    pvm_skip_buffer<config_enc2, UNET_SKIP_PLAN.mem[SKIP_ENC2], UNET_SKIP_PLAN.offset[SKIP_ENC2]>::run(
+        skip_enc2, skip_enc2_out, skip_spill);
+    pvm_downsample<config_enc2>(s_enc2_next, s_enc3_in);
+
+    custom_pvm_layer<config_enc3>(s_enc3_in, s_enc3, layer_mamba[2], layer_params[2], weight_mode);
+    pvm_tee<config_enc3>(s_enc3, s_enc3_next, skip_enc3);
+    pvm_skip_buffer<config_enc3, UNET_SKIP_PLAN.mem[SKIP_ENC3], UNET_SKIP_PLAN.offset[SKIP_ENC3]>::run(
+        skip_enc3, skip_enc3_out, skip_spill);
+    pvm_downsample<config_enc3>(s_enc3_next, s_enc4_in);
+
+    custom_pvm_layer<config_enc4>(s_enc4_in, s_enc4, layer_mamba[3], layer_params[3], weight_mode);
+    pvm_tee<config_enc4>(s_enc4, s_enc5_in, skip_enc4);
+    pvm_skip_buffer<config_enc4, UNET_SKIP_PLAN.mem[SKIP_ENC4], UNET_SKIP_PLAN.offset[SKIP_ENC4]>::run(
+        skip_enc4, skip_enc4_out, skip_spill);
+
+    custom_pvm_layer<config_enc5>(s_enc5_in, s_enc5, layer_mamba[4], layer_params[4], weight_mode);
+    pvm_tee<config_enc5>(s_enc5, s_enc5_next, skip_enc5);
+    pvm_skip_buffer<config_enc5, UNET_SKIP_PLAN.mem[SKIP_ENC5], UNET_SKIP_PLAN.offset[SKIP_ENC5]>::run(
+        skip_enc5, skip_enc5_out, skip_spill);
+    pvm_downsample<config_enc5>(s_enc5_next, s_bott_in);
+
+    // Bottleneck
+    custom_pvm_layer<config_bottleneck>(s_bott_in, s_bott, layer_mamba[5], layer_params[5], weight_mode);
+
+    // Decoder
+    pvm_upsample_add<config_dec5>(s_bott, skip_enc5_out, s_dec5_in);
+    custom_pvm_layer<config_dec5>(s_dec5_in, s_dec5, layer_mamba[6], layer_params[6], weight_mode);
+
+    pvm_skip_add<config_dec4>(s_dec5, skip_enc4_out, s_dec4_in);
+    custom_pvm_layer<config_dec4>(s_dec4_in, s_dec4, layer_mamba[7], layer_params[7], weight_mode);
+
+    pvm_upsample_add<config_dec3>(s_dec4, skip_enc3_out, s_dec3_in);
+    custom_pvm_layer<config_dec3>(s_dec3_in, s_dec3, layer_mamba[8], layer_params[8], weight_mode);
+
+    pvm_upsample_add<config_dec2>(s_dec3, skip_enc2_out, s_dec2_in);
+    custom_pvm_layer<config_dec2>(s_dec2_in, s_dec2, layer_mamba[9], layer_params[9], weight_mode);
+
+    pvm_upsample_add<config_dec1>(s_dec2, skip_enc1_out, s_dec1_in);
+    custom_pvm_layer<config_dec1>(s_dec1_in, s_out, layer_mamba[10], layer_params[10], weight_mode);
+
+    // Segmentation head, then write-back of the features or the classes
+    pvm_seg_head<config_head>(s_out, s_head_params, s_features, s_classes, weight_mode, output_format != OUTPUT_FEATURES);
+    unet_pack_output(s_features, s_classes, s_out_words, output_format);
+    unet_write_output(s_out_words, frame_out, output_format);
+}
+
+void unet_pvm_top(
+    axi_word_t *image_in, 
+    axi_word_t *mask_out, 
+    axi_word_t *weights,
+    ssm_t *skip_spill,
+    int weights_version,
+    int load_weights,
+    int image_format,
+    int output_format
+) {
+    // Depths in packed words (UNET_*_WORDS above), derived from the layer configs
+    // image_in: enc1's H*W*c_in values, or H*W pixels for IMAGE_RGBA8
+    // mask_out: dec1's H*W*c_out values, or H*W class bytes / mask bits
+    // weights: UNET_WEIGHTS_SIZE values (every layer's Mamba block and output projection,
+    //          then the head's classifier)
+    // skip_spill: UNET_SKIP_SPILL_WORDS (1 with the default budgets: every skip fits on chip)
+    // The packed ports burst up to a 4 KB page per request with PVM_AXI_OUTSTANDING requests
+    // in flight, so the I/O runs at one full-width beat per cycle
+    #pragma HLS INTERFACE m_axi port=image_in bundle=gmem0 depth=UNET_IN_WORDS \
+        max_read_burst_length=PVM_AXI_BURST num_read_outstanding=PVM_AXI_OUTSTANDING
+    #pragma HLS INTERFACE m_axi port=mask_out bundle=gmem1 depth=UNET_OUT_WORDS \
+        max_write_burst_length=PVM_AXI_BURST num_write_outstanding=PVM_AXI_OUTSTANDING
+    #pragma HLS INTERFACE m_axi port=weights bundle=gmem2 depth=UNET_WEIGHT_WORDS \
+        max_read_burst_length=PVM_AXI_BURST num_read_outstanding=PVM_AXI_OUTSTANDING
+    #pragma HLS INTERFACE m_axi port=skip_spill bundle=gmem3 depth=UNET_SKIP_SPILL_WORDS
+    #pragma HLS INTERFACE s_axilite port=weights_version
+    #pragma HLS INTERFACE s_axilite port=load_weights
+    #pragma HLS INTERFACE s_axilite port=image_format
+    #pragma HLS INTERFACE s_axilite port=output_format
+    #pragma HLS INTERFACE s_axilite port=return
+
+    // Weight cache. load_weights is a WeightLoad command:
+    //   WEIGHTS_LOAD     - fetch the blob before this frame, which then uses it
+    //   WEIGHTS_PREFETCH - stage the blob behind this frame's compute; it takes effect
+    //                      from the next frame, this one still runs on the old weights
+    // With no command, the blob is loaded on the first call and whenever weights_version
+    // changes. Otherwise every layer keeps its resident copy.
+    static bool weights_resident = false;
+    static int resident_version = 0;
+    int weight_mode = WEIGHTS_RESIDENT;
+    if (!weights_resident) weight_mode = WEIGHTS_LOAD; // nothing to run on yet
+    else if (load_weights == WEIGHTS_PREFETCH) weight_mode = WEIGHTS_PREFETCH;
+    else if (load_weights == WEIGHTS_LOAD || weights_version != resident_version) weight_mode = WEIGHTS_LOAD;
+    weights_resident = true;
+    resident_version = weights_version;
+
+    // One invocation streams the frame through the whole U-Net, straight from image_in
+    // to mask_out
+    // OPTIMIZATION: No input / output frame copies: they serialized the I/O with compute
+    // and cost two frame buffers
+    unet_pvm_pipeline(image_in, mask_out, weights, skip_spill, weight_mode, image_format, output_format);
+}
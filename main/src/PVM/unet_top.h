@@ -2,12 +2,33 @@
 #define UNET_TOP_H
 
 #include "types.h"
+#include "axi_pack.h"
 
-// AXI mapped IP core signature
+// Layout of image_in, chosen by the host per frame
+enum ImageFormat {
+    IMAGE_FIXED = 0, // the enc1 input tensor, packed ssm_t values
+    IMAGE_RGBA8 = 1  // 8-bit pixels, AXI_PIXELS per word; normalized and padded to enc1's
+                     // channels on chip (UNET_PIXEL_NORM)
+};
+
+// Contents of mask_out, chosen by the host per frame
+enum OutputFormat {
+    OUTPUT_FEATURES = 0, // dec1's feature tensor, packed ssm_t values
+    OUTPUT_CLASS_ID = 1, // the head's class per pixel, one byte each, PVM_AXI_BITS / 8 per word
+    OUTPUT_MASK = 2      // one bit per pixel, set where the class is not 0, PVM_AXI_BITS per word
+};
+
+// AXI mapped IP core signature. image_in, mask_out and weights are packed AXI_VALS
+// values per word (axi_pack.h); each tensor starts on a word boundary.
 void unet_pvm_top(
-    ssm_t *image_in,   // Input image [H * W * C]
-    ssm_t *mask_out,   // Output mask [H * W * C]
-    ssm_t *weights     // Flattened array for projection weights/biases
+    axi_word_t *image_in, // Input image: [H * W * C] of config_enc1, or H * W pixels (image_format)
+    axi_word_t *mask_out, // Output: [H * W * C] features of config_dec1, or per-pixel classes (output_format)
+    axi_word_t *weights,  // Flattened per-layer Mamba + projection weights, then the head (UNET_WEIGHTS_SIZE)
+    ssm_t *skip_spill, // DDR region for skips the planner could not keep on chip (UNET_SKIP_SPILL_WORDS)
+    int weights_version, // AXI-lite: blob version; a change triggers a reload
+    int load_weights,    // AXI-lite: 0 none, 1 load before this frame, 2 prefetch for the next frame
+    int image_format,    // AXI-lite: ImageFormat of image_in
+    int output_format    // AXI-lite: OutputFormat of mask_out
 );
 
-#endif
\ No newline at end of file
+#endif
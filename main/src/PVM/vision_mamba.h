@@ -3,16 +3,137 @@
 
 #include "hls_stream.h"
 #include "types.h"
+#include "layers.h"
+#include "s6_layer.h"
+#include "s6_param_gen.h"
 
+// Mamba block on CONFIG_T::d-channel tokens (inner width E = VM_EXPAND * D) for one
+// CONFIG_T::h x CONFIG_T::w frame; CONFIG_T is a vm_config (layers.h)
+template<typename CONFIG_T>
 class VisionMambaBlock {
 public:
-    int H, W, D;
-    VisionMambaBlock(int h, int w, int d) : H(h), W(w), D(d) {}
+    static const int D = CONFIG_T::d;
+    static const int E = CONFIG_T::e;
+    static const int DW = CONFIG_T::d_width;
+    static const int EW = CONFIG_T::e_width;
 
+    // Depth of the residual and gate delay lines. They only have to cover the tokens
+    // in flight on the main path (norm -> conv -> param gen -> S6) when the first SSM
+    // output reaches the output block: the tokens the S6 engine holds back, plus a few
+    // pipeline fills. The streaming engine emits one token per token in and holds none.
+    // The chunked engine banks the whole frame first, and the SSD engine two chunks
+    // (the one being computed and the one being banked).
+    static const int SSD_HELD = 2 * S6Layer<CONFIG_T>::SSD_Q;
+    static const int S6_HELD = (S6_P > 1) ? CONFIG_T::seq_len
+                             : (S6_SSD_CHUNK > 0) ? (SSD_HELD < CONFIG_T::seq_len ? SSD_HELD : CONFIG_T::seq_len)
+                             : 0;
+    static const int DELAY_DEPTH = S6_HELD + 32;
+    static const int RES_DEPTH = DELAY_DEPTH * CONFIG_T::d_beats;  // in stream words
+    static const int GATE_DEPTH = DELAY_DEPTH * CONFIG_T::e_beats;
+
+    // Tokens enter and leave as d_beats words of DW channels. weights carries the
+    // block's learned projections in vm_weights_size(D) order.
     void run(
-        hls::stream<PixelVec> &input_stream,
-        hls::stream<PixelVec> &output_stream
+        hls::stream<PixelVec<DW> > &input_stream,
+        hls::stream<PixelVec<DW> > &output_stream,
+        hls::stream<ssm_t> &weights
     );
 };
 
+// Helper function to act as a producer for the internal streams
+template<int N, int WORDS>
+void split_input(hls::stream<PixelVec<N> > &in, hls::stream<PixelVec<N> > &out1, hls::stream<PixelVec<N> > &out2) {
+    for(int t=0; t<WORDS; t++) {
+        #pragma HLS PIPELINE II=1
+        PixelVec<N> p = in.read();
+        out1.write(p);
+        out2.write(p);
+    }
+}
+
+// Route the block's weight stream to the stages that own each projection
+template<typename CONFIG_T>
+void split_weights(hls::stream<ssm_t> &in,
+                   hls::stream<ssm_t> &w_in_proj, hls::stream<ssm_t> &w_x_proj, hls::stream<ssm_t> &w_out_proj) {
+    const int D = CONFIG_T::d;
+    const int E = CONFIG_T::e;
+    for (int i = 0; i < 2 * E * D; i++) {
+        #pragma HLS PIPELINE II=1
+        w_in_proj.write(in.read());
+    }
+    // x_proj, dt_proj and its bias all belong to the parameter generator
+    for (int i = 0; i < (VM_DT_RANK + 2 * D_STATE) * E + E * VM_DT_RANK + E; i++) {
+        #pragma HLS PIPELINE II=1
+        w_x_proj.write(in.read());
+    }
+    for (int i = 0; i < D * E; i++) {
+        #pragma HLS PIPELINE II=1
+        w_out_proj.write(in.read());
+    }
+}
+
+template<typename CONFIG_T>
+void VisionMambaBlock<CONFIG_T>::run(
+    hls::stream<PixelVec<DW> > &input_stream,
+    hls::stream<PixelVec<DW> > &output_stream,
+    hls::stream<ssm_t> &weights
+) {
+    #pragma HLS INLINE off
+    // Everything inside this region must be a function call or a stream declaration
+    #pragma HLS DATAFLOW
+
+    // A delay line shorter than the S6 hold fills before the first SSM output arrives
+    // and stalls split_input, deadlocking the block
+    static_assert(DELAY_DEPTH > S6_HELD, "residual / gate delay lines must cover the tokens the S6 engine holds back");
+
+    // 1. Internal Stream Declarations (Non-static for instance isolation)
+    hls::stream<PixelVec<DW> > s_res("s_res"), s_in_norm("s_in_norm"), s_norm_out("s_norm");
+    hls::stream<PixelVec<EW> > s_main("s_main"), s_gate("s_gate"), s_conv_out("s_conv");
+    hls::stream<S6Params<EW> > s_params_fwd("s_fwd");
+    hls::stream<PixelVec<EW> > s_ssm_out("s_ssm");
+    hls::stream<ssm_t> w_in_proj("w_in_proj"), w_x_proj("w_x_proj"), w_out_proj("w_out_proj");
+
+    // 2. Set Depths (Crucial for the residual path to prevent deadlock)
+    // FIX: Size the delay lines to the main-path latency, not a fixed 1024 tokens
+    #pragma HLS STREAM variable=s_res depth=RES_DEPTH
+    #pragma HLS STREAM variable=s_gate depth=GATE_DEPTH
+#if S6_SCAN_CHUNKS > 1
+    // Frame-deep delay lines in chunked mode: keep them off the BRAM budget
+    #pragma HLS BIND_STORAGE variable=s_res type=fifo impl=uram
+    #pragma HLS BIND_STORAGE variable=s_gate type=fifo impl=uram
+#endif
+    #pragma HLS STREAM variable=s_main depth=16
+    #pragma HLS STREAM variable=s_in_norm depth=16
+    #pragma HLS STREAM variable=s_norm_out depth=16
+    #pragma HLS STREAM variable=s_ssm_out depth=16
+    #pragma HLS STREAM variable=s_conv_out depth=16
+    #pragma HLS STREAM variable=s_norm_out depth=16
+    #pragma HLS STREAM variable=s_params_fwd depth=16
+    #pragma HLS STREAM variable=w_in_proj depth=16
+    #pragma HLS STREAM variable=w_x_proj depth=16
+    #pragma HLS STREAM variable=w_out_proj depth=16
+    // 3. Local instances of workers to ensure Resource Isolation
+    RMSNorm<CONFIG_T> norm_i;
+    InputProjection<CONFIG_T> in_proj_i;
+    Conv1DBlock<CONFIG_T> conv_i;
+    S6ParamGen<CONFIG_T> param_gen_i;
+    S6Layer<CONFIG_T> ssm_i;
+    OutputBlock<CONFIG_T> out_block_i;
+
+    // 4. Dataflow Functional Pipeline
+    split_weights<CONFIG_T>(weights, w_in_proj, w_x_proj, w_out_proj);
+    split_input<DW, CONFIG_T::seq_len * CONFIG_T::d_beats>(input_stream, s_res, s_in_norm);
+    
+    norm_i.forward(s_in_norm, s_norm_out);
+    in_proj_i.forward(s_norm_out, s_main, s_gate, w_in_proj);
+    conv_i.forward(s_main, s_conv_out);
+    
+    // Call matching your bidirectional definition in s6_param_gen.h
+    param_gen_i.forward(s_conv_out, s_params_fwd, w_x_proj);
+    
+    ssm_i.forward(s_params_fwd, s_ssm_out);
+    
+    out_block_i.forward(s_ssm_out, s_gate, s_res, output_stream, w_out_proj);
+}
+
 #endif
\ No newline at end of file
@@ -1,23 +1,189 @@
 #include "image_preprocess.h"
-#include <string.h> 
 
-void ImagePreprocess::forward(const float *image, hls::stream<PixelVec> &out_stream) {
-    float local_buf[32];
-    #pragma HLS ARRAY_PARTITION variable=local_buf complete
+ssm_t ImagePreprocess::taps[MAX_PATCH_WORDS][MAX_IMG_C][VEC_WIDTH];
+ssm_t ImagePreprocess::bias[MAX_D];
+pos_turn_t ImagePreprocess::pos_freq[MAX_D / 2];
+int ImagePreprocess::loaded_c = 0;
+int ImagePreprocess::loaded_p = 0;
+int ImagePreprocess::loaded_d = 0;
 
-    int L = H * W;
-    for (int t = 0; t < L; t++) {
+ImagePreprocess::ImagePreprocess(int h, int w, int c, int p, int d)
+    : H(h), W(w), C(c), P(p), D(d) {
+    // (x / 255 - mean) / std; alpha passes through as x / 255
+    const float mean[MAX_IMG_C] = {0.485f, 0.456f, 0.406f, 0.0f};
+    const float stdev[MAX_IMG_C] = {0.229f, 0.224f, 0.225f, 1.0f};
+    for (int ci = 0; ci < MAX_IMG_C; ci++) {
+        float m = VIM_PIXEL_NORM ? mean[ci] : 0.0f;
+        float s = VIM_PIXEL_NORM ? stdev[ci] : 1.0f;
+        norm_scale[ci] = 1.0 / (255.0 * s);
+        norm_offset[ci] = -m / s;
+    }
+}
+
+bool ImagePreprocess::weights_loaded(int c, int p, int d) {
+    #pragma HLS INLINE
+    return c == loaded_c && p == loaded_p && d == loaded_d;
+}
+
+void ImagePreprocess::load_weights(int c, int p, int d, const ssm_t *blob) {
+    #pragma HLS INLINE off
+    #pragma HLS ARRAY_RESHAPE variable=taps complete dim=2
+    #pragma HLS ARRAY_RESHAPE variable=taps complete dim=3
+    #pragma HLS ARRAY_PARTITION variable=bias cyclic factor=VEC_WIDTH
+
+    // One tap word is assembled here and written once, as the blob's d-major order
+    // completes it: C values per channel, VEC_WIDTH channels per beat
+    ssm_t word[MAX_IMG_C][VEC_WIDTH];
+    #pragma HLS ARRAY_PARTITION variable=word complete dim=0
+    for (int cc = 0; cc < MAX_IMG_C; cc++)
+        for (int j = 0; j < VEC_WIDTH; j++) word[cc][j] = 0;
+
+    const int beats = vec_beats(d);
+    int k = 0, ch = 0, ci = 0;
+    for (int i = 0; i < p * p * d * c; i++) {
+        #pragma HLS PIPELINE II=1
+        #pragma HLS LOOP_TRIPCOUNT max=MAX_PATCH_WORDS*MAX_IMG_C*VEC_WIDTH
+        word[ci][ch % VEC_WIDTH] = blob[i];
+        if (ci == c - 1 && (ch % VEC_WIDTH == VEC_WIDTH - 1 || ch == d - 1)) {
+            for (int cc = 0; cc < MAX_IMG_C; cc++) {
+                #pragma HLS UNROLL
+                for (int j = 0; j < VEC_WIDTH; j++) {
+                    #pragma HLS UNROLL
+                    taps[k * beats + ch / VEC_WIDTH][cc][j] = word[cc][j];
+                }
+            }
+        }
+        if (++ci == c) {
+            ci = 0;
+            if (++ch == d) { ch = 0; k++; }
+        }
+    }
+    for (int i = 0; i < d; i++) {
+        #pragma HLS PIPELINE II=1
+        #pragma HLS LOOP_TRIPCOUNT max=MAX_D
+        bias[i] = blob[p * p * d * c + i];
+    }
+
+    // Channel pair j runs at 10000^(-2j / d) radians per token: 1 / (2 pi) turns for
+    // pair 0, each next pair slower by the ROM ratio for d
+    pos_turn_t freq = 0.15915494309189535;
+    const pos_turn_t ratio = pos_ratio_rom::ratio_table[d];
+    for (int j = 0; j < (d + 1) / 2; j++) {
+        #pragma HLS PIPELINE
+        #pragma HLS LOOP_TRIPCOUNT max=MAX_D/2
+        pos_freq[j] = freq;
+        freq = freq * ratio;
+    }
+
+    loaded_c = c;
+    loaded_p = p;
+    loaded_d = d;
+}
+
+// Sine of a phase in turns from the quarter-wave ROM, at the nearest ROM step
+static ssm_t pos_embed_sin(pos_turn_t phase) {
+    #pragma HLS INLINE
+    // Registers, not a 1-port BRAM ROM: every vector lane does a lookup per clock
+    #pragma HLS ARRAY_PARTITION variable=pos_sin_rom::sin_table complete
+    phase += pos_turn_t(0.5 / (4 * POS_ROM_SIZE));
+    ap_uint<VIM_POS_ROM_BITS + 2> n = phase.range(31, 32 - (VIM_POS_ROM_BITS + 2));
+    int quadrant = n >> VIM_POS_ROM_BITS;
+    int k = n & (POS_ROM_SIZE - 1);
+    ssm_t v = pos_sin_rom::sin_table[(quadrant & 1) ? POS_ROM_SIZE - k : k];
+    return (quadrant & 2) ? (ssm_t)-v : v;
+}
+
+void ImagePreprocess::forward(const pixel_t *image, hls::stream<PixelVec> &out_stream) {
+    // Pixels of the current row inside the current patch, filled on a token's first beat
+    // and reused by the others
+    ssm_t seg[MAX_PATCH][MAX_IMG_C];
+    #pragma HLS ARRAY_PARTITION variable=seg complete dim=2
+    #pragma HLS ARRAY_PARTITION variable=norm_scale complete
+    #pragma HLS ARRAY_PARTITION variable=norm_offset complete
+
+    // Line buffer of the patch row in flight: partial sums of the rows seen so far,
+    // one word per (patch column, beat)
+    PixelVec acc[MAX_ROW_WORDS];
+    // A word is written only when P >= 2 and comes back one image row, P * WP * beats
+    // >= 2 iterations, later
+    #pragma HLS DEPENDENCE variable=acc inter true distance=2
+
+    // Partial sum of the current patch row segment, over kx
+    ssm_t part[VEC_WIDTH];
+    #pragma HLS ARRAY_PARTITION variable=part complete
+
+    #pragma HLS ARRAY_RESHAPE variable=taps complete dim=2
+    #pragma HLS ARRAY_RESHAPE variable=taps complete dim=3
+    #pragma HLS ARRAY_PARTITION variable=bias cyclic factor=VEC_WIDTH
+    #pragma HLS ARRAY_PARTITION variable=pos_freq cyclic factor=VEC_WIDTH/2
+
+    const int HP = H / P, WP = W / P; // Patch grid; a partial last patch row / column is dropped
+    const int beats = vec_beats(D);
+
+    // Image rows y, patch columns px, beats b, patch columns kx: each pixel of the
+    // covered area is read once, and every beat takes one cycle per pixel
+    int y = 0, py = 0, ky = 0;
+    int px = 0, b = 0, kx = 0;
+    for (int i = 0; i < HP * P * WP * beats * P; i++) {
         #pragma HLS PIPELINE II=1
-        // Burst read copies a block from DDR to local BRAM
-        // This prevents the AXI bus from locking up during DATAFLOW
-        memcpy(local_buf, image + (t * D), D * sizeof(float));
+        if (b == 0) {
+            // One 32-bit word per pixel, however many channels are used
+            pixel_t pix = image[y * W + px * P + kx];
+            for (int c = 0; c < MAX_IMG_C; c++) {
+                #pragma HLS UNROLL
+                int byte = pix.range(8 * c + 7, 8 * c).to_int();
+                seg[kx][c] = (c < C) ? (ssm_t)(byte * norm_scale[c] + norm_offset[c]) : (ssm_t)0;
+            }
+        }
 
-        PixelVec vec;
-        #pragma HLS ARRAY_PARTITION variable=vec.data complete
-        for (int d = 0; d < 32; d++) {
+        for (int d = 0; d < VEC_WIDTH; d++) {
             #pragma HLS UNROLL
-            vec.data[d] = (d < D) ? (ssm_t)local_buf[d] : (ssm_t)0;
+            ssm_t s = 0;
+            for (int c = 0; c < MAX_IMG_C; c++) {
+                #pragma HLS UNROLL
+                s += taps[(ky * P + kx) * beats + b][c][d] * seg[kx][c];
+            }
+            part[d] = (kx == 0) ? s : (ssm_t)(part[d] + s);
+        }
+
+        if (kx == P - 1) {
+            // Row segment done: fold it into the patch, and emit the beat after the last row
+            int word = px * beats + b;
+            int t = py * WP + px;
+            PixelVec sum = acc[word];
+            PixelVec vec;
+            #pragma HLS ARRAY_PARTITION variable=vec.data complete
+
+            // Channel pair (2j, 2j+1) holds sin / cos of token t's phase t * pos_freq[j]
+            ssm_t pe[VEC_WIDTH];
+            #pragma HLS ARRAY_PARTITION variable=pe complete
+            for (int j = 0; j < VEC_WIDTH / 2; j++) {
+                #pragma HLS UNROLL
+                pos_turn_t phase = t * pos_freq[b * (VEC_WIDTH / 2) + j];
+                pe[2 * j] = VIM_POS_EMBED ? pos_embed_sin(phase) : (ssm_t)0;
+                pe[2 * j + 1] = VIM_POS_EMBED ? pos_embed_sin(phase + pos_turn_t(0.25)) : (ssm_t)0;
+            }
+
+            for (int d = 0; d < VEC_WIDTH; d++) {
+                #pragma HLS UNROLL
+                int ch = b * VEC_WIDTH + d;
+                sum.data[d] = (ky == 0) ? part[d] : (ssm_t)(sum.data[d] + part[d]);
+                vec.data[d] = (ch < D) ? (ssm_t)(sum.data[d] + bias[ch] + pe[d]) : (ssm_t)0;
+            }
+            if (ky == P - 1) out_stream.write(vec);
+            else             acc[word] = sum;
+        }
+
+        if (++kx == P) {
+            kx = 0;
+            if (++b == beats) {
+                b = 0;
+                if (++px == WP) {
+                    px = 0;
+                    y++;
+                    if (++ky == P) { ky = 0; py++; }
+                }
+            }
         }
-        out_stream.write(vec);
     }
-}
\ No newline at end of file
+}
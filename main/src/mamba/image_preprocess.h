@@ -3,16 +3,118 @@
 
 #include "hls_stream.h"
 #include "types.h"
+#include <utility>
 
+// Patch-embedding limits: patch side, image channels, the stream words (tokens x beats)
+// of one row of patches, and the tap words (P * P * vec_beats(D)) of the conv. A tap
+// word holds MAX_IMG_C x VEC_WIDTH taps, so the table is one 512 x 3072-bit memory
+// (43 BRAM36 in 512 x 72 mode); the limit costs no more BRAM up to the 512-deep mode.
+const int MAX_PATCH = 16;
+const int MAX_IMG_C = 4;
+const int MAX_ROW_WORDS = 256;
+const int MAX_PATCH_WORDS = 512;
+static_assert(MAX_PATCH_WORDS >= MAX_PATCH * MAX_PATCH, "a full-size patch must fit at one beat");
+
+// Sinusoidal position embedding on the tokens (0 leaves the patch embedding as is)
+#ifndef VIM_POS_EMBED
+#define VIM_POS_EMBED 1
+#endif
+
+// Position embedding ROM: a quarter sine wave of 2^VIM_POS_ROM_BITS steps, looked up at
+// the nearest of 4 * 2^VIM_POS_ROM_BITS phases per turn.
+//   8 bits (default): within 3.1e-3 of sin, a 257-entry LUT ROM per lane
+//   10 bits:          within 7.7e-4, a 1025-entry LUT ROM per lane
+#ifndef VIM_POS_ROM_BITS
+#define VIM_POS_ROM_BITS 8
+#endif
+const int POS_ROM_SIZE = 1 << VIM_POS_ROM_BITS;
+
+// Pixel normalization: 0 maps bytes to [0, 1] (x / 255), 1 applies the ImageNet
+// per-channel mean / std on top of that
+#ifndef VIM_PIXEL_NORM
+#define VIM_PIXEL_NORM 0
+#endif
+
+// Per-channel affine map of a byte, x * scale + offset. 28 fraction bits keep the
+// scale exact enough that the result rounds like the float expression.
+typedef ap_fixed<32, 4> pixel_norm_t;
+
+// Phase in turns, and a channel pair's frequency in turns per token; wraps mod 1
+typedef ap_ufixed<32, 0> pos_turn_t;
+
+// sin(x) and exp(x <= 0) in double, evaluated at compile time for the ROMs below
+constexpr double pos_sin(double x) {
+    double s = 0, term = x;
+    for (int k = 1; k < 24; k += 2) {
+        s += term;
+        term *= -x * x / ((k + 1) * (k + 2));
+    }
+    return s;
+}
+
+constexpr double pos_exp(double x) {
+    int n = 0;
+    while (x < -0.01) { x /= 2; n++; }
+    double s = 1, term = 1;
+    for (int k = 1; k < 12; k++) { term *= x / k; s += term; }
+    while (n-- > 0) s *= s;
+    return s;
+}
+
+// Entry k of the quarter wave: sin(pi / 2 * k / POS_ROM_SIZE), k = 0 .. POS_ROM_SIZE
+constexpr double pos_quarter_sin(int k) { return pos_sin(1.5707963267948966 * k / POS_ROM_SIZE); }
+
+// Entry d: the ratio 10000^(-2 / d) between the frequencies of neighbouring channel
+// pairs of a d-channel token (entry 0 unused)
+constexpr double pos_pair_ratio(int d) { return (d > 0) ? pos_exp(-2.0 * 9.210340371976184 / d) : 0.0; }
+
+template<typename SEQ> struct pos_rom;
+template<int... I> struct pos_rom<std::integer_sequence<int, I...>> {
+    static const ssm_t sin_table[sizeof...(I)];
+    static const pos_turn_t ratio_table[sizeof...(I)];
+};
+template<int... I>
+const ssm_t pos_rom<std::integer_sequence<int, I...>>::sin_table[sizeof...(I)] = {ssm_t(pos_quarter_sin(I))...};
+template<int... I>
+const pos_turn_t pos_rom<std::integer_sequence<int, I...>>::ratio_table[sizeof...(I)] = {pos_turn_t(pos_pair_ratio(I))...};
+
+typedef pos_rom<std::make_integer_sequence<int, POS_ROM_SIZE + 1>> pos_sin_rom;
+typedef pos_rom<std::make_integer_sequence<int, MAX_D + 1>> pos_ratio_rom;
+
+// Values in the patch-embedding weight blob: the taps [ky][kx][d][c] of the P x P conv,
+// then the D biases
+inline int embed_weights_size(int c, int p, int d) {
+#pragma HLS INLINE
+    return p * p * d * c + d;
+}
+
+// Patch embedding: a P x P, stride-P convolution from the C-channel H x W image to
+// D-channel tokens, one per patch, in raster order of the (H/P) x (W/P) patch grid.
+// The image arrives as 8-bit pixels, normalized here; channels past C are zero.
+// The position embedding is added as each token leaves.
 class ImagePreprocess {
 public:
     // Local constructor prevents linker "undefined symbol" errors
-    ImagePreprocess(int h, int w, int d) : H(h), W(w), D(d) {}
-    
-    void forward(const float *image, hls::stream<PixelVec> &out_stream);
+    ImagePreprocess(int h, int w, int c, int p, int d);
+
+    // Taps and bias are resident: load_weights() lays a blob out for one (C, P, D), and
+    // forward() runs only on the geometry they were loaded for
+    static void load_weights(int c, int p, int d, const ssm_t *blob);
+    static bool weights_loaded(int c, int p, int d);
+
+    void forward(const pixel_t *image, hls::stream<PixelVec> &out_stream);
 
 private:
-    int H, W, D;
+    int H, W, C, P, D;
+    pixel_norm_t norm_scale[MAX_IMG_C];
+    pixel_norm_t norm_offset[MAX_IMG_C];
+
+    // Resident tables: the conv taps, one word per (ky * P + kx, beat), the bias, and
+    // each channel pair's position frequency
+    static ssm_t taps[MAX_PATCH_WORDS][MAX_IMG_C][VEC_WIDTH];
+    static ssm_t bias[MAX_D];
+    static pos_turn_t pos_freq[MAX_D / 2];
+    static int loaded_c, loaded_p, loaded_d;
 };
 
-#endif
\ No newline at end of file
+#endif
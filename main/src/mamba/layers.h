@@ -9,14 +9,18 @@
 
 
 // --- Class 1: RMS Normalization ---
+// The sum of squares accumulates over a token's beats, which are buffered meanwhile.
+// The scaled beats go out from the cycle the last one arrives, while the next token's
+// beats come in: tok is double-buffered on token parity, so a token costs beats cycles
+// like the stages around it.
 class RMSNorm {
     int D;
-    ssm_t weights[32];
+    ssm_t weights[MAX_D];
 
 
 public:
     RMSNorm(int d) : D(d) {
-        for(int i=0; i<32; i++) weights[i] = 1.0;
+        for(int i=0; i<MAX_D; i++) weights[i] = 1.0;
     }
 
 
@@ -25,27 +29,48 @@ public:
         hls::stream<PixelVec> &in_stream,
         hls::stream<PixelVec> &out_stream
     ) {
-        for(int t=0; t<L; t++) {
+        #pragma HLS ARRAY_PARTITION variable=weights cyclic factor=VEC_WIDTH
+        const int beats = vec_beats(D);
+        // Mean-square scale: D is a run-time port, so its reciprocal is taken once per frame
+        const rsqrt_in_t inv_d = rsqrt_in_t(1) / D;
+        ssm_t tok[2][MAX_D];
+        #pragma HLS ARRAY_PARTITION variable=tok complete dim=1
+        #pragma HLS ARRAY_PARTITION variable=tok cyclic factor=VEC_WIDTH dim=2
+        ssm_t sum_sq = 0;
+        ssm_t rsqrt = 0;
+
+        // Input beat i and output beat i - (beats - 1): a token's beats go out in the
+        // cycles its last beat and the next token's first beats-1 come in
+        int t_in = 0, b_in = 0, t_out = 0, b_out = 0;
+        for(int i=0; i<L * beats + beats - 1; i++) {
 #pragma HLS PIPELINE II=1
-            PixelVec in_vec = in_stream.read();
-            PixelVec out_vec;
+            if (t_in < L) {
+                PixelVec in_vec = in_stream.read();
 
-
-            ssm_t sum_sq = 0;
-            for(int d=0; d<32; d++) {
+                if (b_in == 0) sum_sq = 0;
+                for(int d=0; d<VEC_WIDTH; d++) {
 #pragma HLS UNROLL
-                if(d < D) sum_sq += in_vec.data[d] * in_vec.data[d];
+                    int c = b_in * VEC_WIDTH + d;
+                    if(c < D) sum_sq += in_vec.data[d] * in_vec.data[d];
+                    tok[t_in & 1][c] = in_vec.data[d];
+                }
+                // OPTIMIZATION: Fixed-point inverse square root, no float divide / sqrt
+                if (b_in == beats - 1) {
+                    rsqrt = rsqrt_fixed((rsqrt_in_t)(sum_sq * inv_d) + rsqrt_in_t(0.0001));
+                }
+                if (++b_in == beats) { b_in = 0; t_in++; }
             }
-           
-            ssm_t rsqrt = ssm_t(1.0) / hls::sqrt(sum_sq / ssm_t(D) + ssm_t(0.0001));
-
-
-            for(int d=0; d<32; d++) {
+            if (i >= beats - 1) {
+                PixelVec out_vec;
+                for(int d=0; d<VEC_WIDTH; d++) {
 #pragma HLS UNROLL
-                if(d < D) out_vec.data[d] = in_vec.data[d] * rsqrt * weights[d];
-                else      out_vec.data[d] = 0;
+                    int c = b_out * VEC_WIDTH + d;
+                    if(c < D) out_vec.data[d] = tok[t_out & 1][c] * rsqrt * weights[c];
+                    else      out_vec.data[d] = 0;
+                }
+                out_stream.write(out_vec);
+                if (++b_out == beats) { b_out = 0; t_out++; }
             }
-            out_stream.write(out_vec);
         }
     }
 };
@@ -64,7 +89,7 @@ public:
         hls::stream<PixelVec> &main_branch,
         hls::stream<PixelVec> &gate_branch
     ) {
-        for(int t=0; t<L; t++) {
+        for(int t=0; t<L * vec_beats(D); t++) {
 #pragma HLS PIPELINE II=1
             PixelVec x = in_stream.read();
             main_branch.write(x);
@@ -75,18 +100,19 @@ public:
 
 
 // --- Class 3: Causal Convolution ---
+// Every channel keeps its own history; beat b of a token updates channels b * VEC_WIDTH ..
 class Conv1DBlock {
     int D;
-    ssm_t line_buffer[2][32];
-    ssm_t weights[3][32];
+    ssm_t line_buffer[2][MAX_D];
+    ssm_t weights[3][MAX_D];
 
 
 public:
     Conv1DBlock(int d) : D(d) {
         for(int r=0; r<2; r++)
-            for(int i=0; i<32; i++) line_buffer[r][i] = 0;
+            for(int i=0; i<MAX_D; i++) line_buffer[r][i] = 0;
         for(int k=0; k<3; k++)
-            for(int i=0; i<32; i++) weights[k][i] = 0.33;
+            for(int i=0; i<MAX_D; i++) weights[k][i] = 0.33;
     }
 
 
@@ -95,33 +121,40 @@ public:
         hls::stream<PixelVec> &in_stream,
         hls::stream<PixelVec> &out_stream
     ) {
-        for(int t=0; t<L; t++) {
+        #pragma HLS ARRAY_PARTITION variable=line_buffer cyclic factor=VEC_WIDTH dim=2
+        #pragma HLS ARRAY_PARTITION variable=weights cyclic factor=VEC_WIDTH dim=2
+        const int beats = vec_beats(D);
+        int b = 0;
+        for(int t=0; t<L * beats; t++) {
 #pragma HLS PIPELINE II=1
             PixelVec in_vec = in_stream.read();
             PixelVec out_vec;
 
 
-            for(int d=0; d<32; d++) {
+            for(int d=0; d<VEC_WIDTH; d++) {
 #pragma HLS UNROLL
-                if(d < D) {
-                    ssm_t conv_val = in_vec.data[d] * weights[0][d] +
-                                     line_buffer[0][d] * weights[1][d] +
-                                     line_buffer[1][d] * weights[2][d];
+                int c = b * VEC_WIDTH + d;
+                if(c < D) {
+                    ssm_t conv_val = in_vec.data[d] * weights[0][c] +
+                                     line_buffer[0][c] * weights[1][c] +
+                                     line_buffer[1][c] * weights[2][c];
                    
-                    line_buffer[1][d] = line_buffer[0][d];
-                    line_buffer[0][d] = in_vec.data[d];
+                    line_buffer[1][c] = line_buffer[0][c];
+                    line_buffer[0][c] = in_vec.data[d];
 
 
                     out_vec.data[d] = silu_approx(conv_val);
                 }
             }
             out_stream.write(out_vec);
+            if (++b == beats) b = 0;
         }
     }
 };
 
 
 // --- Class 4: Output Block ---
+// Merges the forward and backward scans: y = (s_fwd + s_bwd) * silu(gate) + residual
 class OutputBlock {
     int D;
 public:
@@ -130,35 +163,41 @@ public:
 
     void forward(
         int L,
-        hls::stream<PixelVec> &ssm_stream,
+        hls::stream<PixelVec> &ssm_fwd_stream,
+        hls::stream<PixelVec> &ssm_bwd_stream,
         hls::stream<PixelVec> &gate_stream,
         hls::stream<PixelVec> &residual_stream,
         hls::stream<PixelVec> &final_out
     ) {
-        for(int t=0; t<L; t++) {
+        const int beats = vec_beats(D);
+        int b = 0;
+        for(int t=0; t<L * beats; t++) {
 #pragma HLS PIPELINE II=1
-            PixelVec s = ssm_stream.read();
+            PixelVec sf = ssm_fwd_stream.read();
+            PixelVec sb = ssm_bwd_stream.read();
             PixelVec g = gate_stream.read();
             PixelVec r = residual_stream.read();
             PixelVec y;
 
 
-            for(int d=0; d<32; d++) {
+            for(int d=0; d<VEC_WIDTH; d++) {
 #pragma HLS UNROLL
-                if(d < D) {
+                if(b * VEC_WIDTH + d < D) {
                     ssm_t gate_act = silu_approx(g.data[d]);
-                    ssm_t fused = s.data[d] * gate_act;
+                    ssm_t fused = (sf.data[d] + sb.data[d]) * gate_act;
                     y.data[d] = fused + r.data[d];
                 }
             }
             final_out.write(y);
+            if (++b == beats) b = 0;
         }
     }
 };
 
 
 // --- Class 5: Splitter (NEW) ---
-// Encapsulates the input splitting logic to satisfy Dataflow requirements
+// Encapsulates the input splitting logic to satisfy Dataflow requirements.
+// L counts stream words (tokens times beats).
 class Splitter {
 public:
     void forward(
@@ -177,4 +216,45 @@ public:
 };
 
 
+// --- Class 6: Token Reverser ---
+// Frame-sized reversal buffer for the backward scan. store() and load_reversed()
+// are separate dataflow processes sharing buf, so HLS implements it as a ping-pong
+// buffer: frame n is read out backwards while frame n+1 is written. Tokens are
+// reversed, the beats within a token keep their order.
+class TokenReverser {
+    int D;
+public:
+    TokenReverser(int d) : D(d) {}
+
+
+    void store(
+        int L,
+        hls::stream<PixelVec> &in_stream,
+        PixelVec buf[MAX_SEQ_LEN]
+    ) {
+        for(int i=0; i<L * vec_beats(D); i++) {
+#pragma HLS PIPELINE II=1
+#pragma HLS LOOP_TRIPCOUNT max=MAX_SEQ_LEN
+            buf[i] = in_stream.read();
+        }
+    }
+
+
+    void load_reversed(
+        int L,
+        PixelVec buf[MAX_SEQ_LEN],
+        hls::stream<PixelVec> &out_stream
+    ) {
+        const int beats = vec_beats(D);
+        int t = L - 1, b = 0;
+        for(int i=0; i<L * beats; i++) {
+#pragma HLS PIPELINE II=1
+#pragma HLS LOOP_TRIPCOUNT max=MAX_SEQ_LEN
+            out_stream.write(buf[t * beats + b]);
+            if (++b == beats) { b = 0; t--; }
+        }
+    }
+};
+
+
 #endif
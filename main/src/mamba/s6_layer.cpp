@@ -8,26 +8,31 @@ void S6Layer::forward(
     hls::stream<S6Params> &in_stream,
     hls::stream<PixelVec> &out_stream
 ) {
-    // Persistent state
-    static ssm_t state[32];
-    #pragma HLS ARRAY_PARTITION variable=state complete
+    // Per-call state: a static here would be shared by the forward and backward
+    // S6Layer instances and serialize them
+    // One state per channel; beat b of a token updates channels b * VEC_WIDTH ..
+    ssm_t state[MAX_D];
+    #pragma HLS ARRAY_PARTITION variable=state cyclic factor=VEC_WIDTH
 
     // FIX: Reset State at start of frame
-    for (int d = 0; d < 32; d++) {
+    for (int d = 0; d < MAX_D; d++) {
         #pragma HLS UNROLL
         state[d] = 0;
     }
 
-    for (int t = 0; t < L; t++) {
+    const int beats = vec_beats(D);
+    int bt = 0;
+    for (int t = 0; t < L * beats; t++) {
 #pragma HLS PIPELINE II=1
-#pragma HLS LOOP_TRIPCOUNT min=1024 max=1024 avg=1024
+#pragma HLS LOOP_TRIPCOUNT max=MAX_SEQ_LEN
         S6Params p = in_stream.read();
         PixelVec out_vec;
         #pragma HLS ARRAY_PARTITION variable=out_vec.data complete
 
-        for (int d = 0; d < 32; d++) {
+        for (int d = 0; d < VEC_WIDTH; d++) {
 #pragma HLS UNROLL
-            if (d < D) {
+            int ch = bt * VEC_WIDTH + d;
+            if (ch < D) {
                 ssm_t dt = p.delta[d];
                 ssm_t b  = p.B[d];
                 ssm_t c  = p.C[d];
@@ -35,12 +40,12 @@ void S6Layer::forward(
 
                 ssm_t decay = exp_lut_approx(dt);
                
-                ssm_t current_state = state[d];
+                ssm_t current_state = state[ch];
                 // SSM Recurrence: h' = A*h + B*x
                 // Note: A is implicit in 'decay' (A_bar = exp(dt * A))
                 ssm_t next_state = decay * current_state + dt * b * x;
                
-                state[d] = next_state;
+                state[ch] = next_state;
                 
                 // Output: y = C * h
                 out_vec.data[d] = c * next_state;
@@ -49,5 +54,6 @@ void S6Layer::forward(
             }
         }
         out_stream.write(out_vec);
+        if (++bt == beats) bt = 0;
     }
 }
\ No newline at end of file
@@ -42,7 +42,9 @@ void S6ParamGen::forward(
     hls::stream<PixelVec> &in_stream,
     hls::stream<S6Params> &out_stream
 ) {
-    for (int t = 0; t < L; t++) {
+    const int beats = vec_beats(D);
+    int b = 0;
+    for (int t = 0; t < L * beats; t++) {
 #pragma HLS PIPELINE II=1
         PixelVec p = in_stream.read();
         S6Params params;
@@ -52,9 +54,9 @@ void S6ParamGen::forward(
         #pragma HLS ARRAY_PARTITION variable=params.x complete
 
 
-        for (int d = 0; d < 32; d++) {
+        for (int d = 0; d < VEC_WIDTH; d++) {
 #pragma HLS UNROLL
-            if (d < D) {
+            if (b * VEC_WIDTH + d < D) {
                 // FIXED: Explicitly cast the constant to the fixed-point type
                 float val = (float)((ssm_t)0.1 * p.data[d]);
                
@@ -66,5 +68,6 @@ void S6ParamGen::forward(
             }
         }
         out_stream.write(params);
+        if (++b == beats) b = 0;
     }
 }
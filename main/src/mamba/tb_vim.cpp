@@ -3,13 +3,23 @@
 #include <fstream>
 #include <string>
 #include "top.h"
+#include "activations.h"
+#include <cmath>
 
 #define H 32
 #define W 32
-#define D 3
+#define C 3 // Image channels (RGB)
+#define P 4 // Patch side: an 8 x 8 grid of tokens
+#define D 3 // Token channels, kept at 3 so the output is viewable as an image
+
+// --- Helper: Pack one RGB pixel (alpha opaque) ---
+pixel_t pack_rgb(int r, int g, int b) {
+    return (pixel_t)(r | (g << 8) | (b << 16) | (0xFFu << 24));
+}
 
 // --- Helper: Load PPM Image ---
-bool load_ppm(const char *filename, std::vector<float> &buffer, std::ofstream &log) {
+// Pixels go to the kernel as they are in the file: 8-bit R, G, B packed into pixel_t
+bool load_ppm(const char *filename, std::vector<pixel_t> &buffer, std::ofstream &log) {
     std::ifstream file(filename, std::ios::binary);
     if (!file) {
         log << "[WARNING] Could not open " << filename << ". Using dummy data." << std::endl;
@@ -20,24 +30,25 @@ bool load_ppm(const char *filename, std::vector<float> &buffer, std::ofstream &l
     file >> type >> w >> h >> max_val;
     file.get(); // skip newline
     
-    buffer.resize(H * W * D);
+    buffer.resize(H * W);
     if (type == "P6") {
-        std::vector<unsigned char> temp(H * W * D);
+        std::vector<unsigned char> temp(H * W * 3);
         file.read(reinterpret_cast<char*>(temp.data()), temp.size());
-        for (size_t i = 0; i < temp.size(); i++) buffer[i] = temp[i] / 255.0f;
+        for (int i = 0; i < H * W; i++) buffer[i] = pack_rgb(temp[3 * i], temp[3 * i + 1], temp[3 * i + 2]);
     } else {
-        int val;
-        for (int i = 0; i < H * W * D; i++) { file >> val; buffer[i] = val / 255.0f; }
+        int r, g, b;
+        for (int i = 0; i < H * W; i++) { file >> r >> g >> b; buffer[i] = pack_rgb(r, g, b); }
     }
     log << "[INFO] Loaded real image: " << filename << std::endl;
     return true;
 }
 
 // --- Helper: Save PPM ---
+// One pixel per token of the patch grid
 void save_ppm(const char *filename, const std::vector<float> &buffer) {
     std::ofstream file(filename);
-    file << "P3\n" << W << " " << H << "\n255\n";
-    for (int i = 0; i < H * W * D; i++) {
+    file << "P3\n" << W / P << " " << H / P << "\n255\n";
+    for (int i = 0; i < (H / P) * (W / P) * D; i++) {
         int val = (int)(buffer[i] * 255.0f);
         if (val < 0) val = 0; if (val > 255) val = 255;
         file << val << " ";
@@ -49,17 +60,74 @@ int main() {
     std::ofstream log("simulation_log.txt");
     if (!log.is_open()) return 1;
 
-    std::vector<float> image(H * W * D);
-    std::vector<float> output(H * W * D);
+    // Fixed-point rsqrt unit of RMSNorm against the float path it replaced, over every
+    // ssm_t operand from the norm's epsilon to 128
+    const double lsb = 1.0 / 65536;
+    double max_err = 0;
+    for(long raw=6; raw<(128L << 16); raw++) {
+        rsqrt_in_t v = (rsqrt_in_t)(raw * lsb);
+        ssm_t ref = (ssm_t)(1.0f / std::sqrt((float)v));
+        double err = std::fabs((double)rsqrt_fixed(v) - (double)ref);
+        if(err > max_err) max_err = err;
+    }
+    log << "[INFO] rsqrt unit max error: " << max_err / lsb << " LSB" << std::endl;
+    if(RSQRT_NEWTON >= 2 && max_err > lsb) {
+        log << "[FAIL] rsqrt unit exceeds 1 LSB of the float path." << std::endl;
+        return 1;
+    }
+
+    std::vector<pixel_t> image(H * W);
+    std::vector<float> output((H / P) * (W / P) * D);
 
     // Load Data
     if (!load_ppm("C:/RP-FPGA/input.ppm", image, log)) {
-        for(int i=0; i<H*W*D; i++) image[i] = (float)(i % 255) / 255.0f;
+        for(int i=0; i<H*W; i++) image[i] = pack_rgb((3 * i) % 255, (3 * i + 1) % 255, (3 * i + 2) % 255);
     }
 
+    // Patch-embedding weights, taps [ky][kx][d][c] then biases: output channel d is the
+    // patch mean of image channel d % C
+    std::vector<ssm_t> weights(embed_weights_size(C, P, D), (ssm_t)0);
+    for(int k=0; k<P*P; k++)
+        for(int d=0; d<D; d++)
+            for(int c=0; c<C; c++)
+                weights[(k * D + d) * C + c] = (d % C == c) ? (ssm_t)(1.0f / (P * P)) : (ssm_t)0;
+
     // Run Hardware
     log << "[INFO] Running vim_top..." << std::endl;
-    vim_top(H, W, D, image.data(), output.data());
+    if (vim_top(H, W, C, P, D, image.data(), weights.data(), 1, output.data()) != VIM_OK) {
+        log << "[FAIL] vim_top rejected the test geometry." << std::endl;
+        return 1;
+    }
+
+    // The taps stay resident: a frame without a load matches bit for bit, and a
+    // geometry they were not loaded for is refused
+    std::vector<float> resident(output.size(), 0.0f);
+    std::vector<ssm_t> stale(weights.size(), (ssm_t)0);
+    if (vim_top(H, W, C, P, D, image.data(), stale.data(), 0, resident.data()) != VIM_OK || resident != output) {
+        log << "[FAIL] Resident-weight frame differs." << std::endl;
+        return 1;
+    }
+    std::vector<float> rejected(H * W * 64, -1.0f);
+    if (vim_top(H, W, C, 2, D, image.data(), stale.data(), 0, rejected.data()) != VIM_NO_WEIGHTS) {
+        log << "[FAIL] vim_top ran a patch size its taps were not loaded for." << std::endl;
+        return 1;
+    }
+
+    // A frame past the on-chip buffers (1024 tokens of 2 words) must be refused
+    // without touching the output
+    if (vim_top(H, W, C, 1, 64, image.data(), stale.data(), 0, rejected.data()) != VIM_BAD_GEOMETRY) {
+        log << "[FAIL] vim_top accepted a frame past MAX_SEQ_LEN." << std::endl;
+        return 1;
+    }
+    // A single row of 32 tokens of 16 words fits the frame but not the row line buffer
+    if (vim_top(1, W, C, 1, 512, image.data(), stale.data(), 0, rejected.data()) != VIM_BAD_GEOMETRY) {
+        log << "[FAIL] vim_top accepted a patch row past MAX_ROW_WORDS." << std::endl;
+        return 1;
+    }
+    for(float f : rejected) if(f != -1.0f) {
+        log << "[FAIL] Rejected frame wrote the output." << std::endl;
+        return 1;
+    }
 
     // Save & Verify
     save_ppm("output_processed_new.ppm", output);
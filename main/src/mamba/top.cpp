@@ -6,10 +6,10 @@
 
 // Process 1: Hardware-Aware Input Mover
 // Optimized for burst reading and initial patch embedding with position injection
-void input_proc(int H, int W, int D, const float *image, hls::stream<PixelVec> &out_s) {
+void input_proc(int H, int W, int C, int P, int D, const pixel_t *image, hls::stream<PixelVec> &out_s) {
     #pragma HLS INLINE off
-    ImagePreprocess input_converter(H, W, D);
-    // forward() now handles float-to-fixed casting and position embedding injection
+    ImagePreprocess input_converter(H, W, C, P, D);
+    // forward() patch-embeds the pixels into D-channel tokens and adds the position embedding
     input_converter.forward(image, out_s);
 }
 
@@ -26,46 +26,88 @@ void mamba_proc(int H, int W, int D, hls::stream<PixelVec> &in_s, hls::stream<Pi
 // Ensures high-bandwidth write-out of segmentation masks/features to DDR
 void write_back_burst(int H, int W, int D, hls::stream<PixelVec> &in, float *out) {
     #pragma HLS INLINE off
-    float buffer[32];
+    float buffer[VEC_WIDTH];
     #pragma HLS ARRAY_PARTITION variable=buffer complete
     int L = H * W; 
+    const int beats = vec_beats(D);
 
-    for(int t = 0; t < L; t++) {
+    int t = 0, b = 0;
+    for(int i = 0; i < L * beats; i++) {
         #pragma HLS PIPELINE II=1
         PixelVec v = in.read();
+        int c0 = b * VEC_WIDTH;
+        int n = (D - c0 < VEC_WIDTH) ? D - c0 : VEC_WIDTH;
         
-        for(int d = 0; d < 32; d++) {
+        for(int d = 0; d < VEC_WIDTH; d++) {
             #pragma HLS UNROLL
             // Cast back to float only at the very boundary to save LUTs in core logic
-            buffer[d] = (d < D) ? (float)v.data[d] : 0.0f;
+            buffer[d] = (d < n) ? (float)v.data[d] : 0.0f;
         }
         // memcpy triggers AXI burst mode, essential for avoiding II=32 bottleneck
-        memcpy(out + (t * D), buffer, D * sizeof(float));
+        memcpy(out + (t * D + c0), buffer, n * sizeof(float));
+        if (++b == beats) { b = 0; t++; }
     }
 }
 
-void vim_top(int H, int W, int D, const float *image, float *output) {
+// Frame geometry the buffers below are sized for (see top.h)
+static bool vim_geometry_ok(int H, int W, int C, int P, int D) {
+    #pragma HLS INLINE
+    if (P < 1 || P > MAX_PATCH || H < P || W < P) return false;
+    if (C < 1 || C > MAX_IMG_C || D < 1 || D > MAX_D) return false;
+    // Beats multiply the tokens: the bounds are in stream words, for the frame and for
+    // the patch embedding's row line buffer
+    int HP = H / P, WP = W / P, beats = vec_beats(D);
+    if (HP > MAX_SEQ_LEN || WP > MAX_SEQ_LEN || HP * WP > MAX_SEQ_LEN) return false;
+    return HP * WP * beats <= MAX_SEQ_LEN && WP * beats <= MAX_ROW_WORDS &&
+           P * P * beats <= MAX_PATCH_WORDS;
+}
+
+// One frame: DATAFLOW enables task-level parallelism (Overlapping Input/Compute/Output)
+static void vim_frame(int H, int W, int C, int P, int D, const pixel_t *image, float *output) {
+    #pragma HLS INLINE off
+    // Global streams linking the processes. 
+    // Static ensures persistence, depth prevents backpressure during bidirectional processing.
+    static hls::stream<PixelVec> stream_in("stream_in");
+    static hls::stream<PixelVec> stream_out("stream_out");
+    #pragma HLS STREAM variable=stream_in  depth=512
+    #pragma HLS STREAM variable=stream_out depth=512
+
+    #pragma HLS DATAFLOW
+    // The Mamba block scans the (H / P) x (W / P) patch grid, not the pixels
+    input_proc(H, W, C, P, D, image, stream_in);
+    mamba_proc(H / P, W / P, D, stream_in, stream_out);
+    write_back_burst(H / P, W / P, D, stream_out, output);
+}
+
+int vim_top(int H, int W, int C, int P, int D, const pixel_t *image, const ssm_t *weights,
+            int load_weights, float *output) {
     // Port configurations for high-performance memory mapping
-    #pragma HLS INTERFACE m_axi port=image  offset=slave bundle=gmem0 depth=3072 \
+    // image: one 32-bit word per pixel (32 * 32 for the testbench)
+    #pragma HLS INTERFACE m_axi port=image  offset=slave bundle=gmem0 depth=1024 \
         max_read_burst_length=256 num_read_outstanding=16
+    // weights: the patch-embedding blob (4 * 4 * 3 * 3 taps and 3 biases for the testbench)
+    #pragma HLS INTERFACE m_axi port=weights offset=slave bundle=gmem2 depth=147 \
+        max_read_burst_length=256
     #pragma HLS INTERFACE m_axi port=output offset=slave bundle=gmem1 depth=3072 \
         max_write_burst_length=256 num_write_outstanding=16
     
     #pragma HLS INTERFACE s_axilite port=H
     #pragma HLS INTERFACE s_axilite port=W
+    #pragma HLS INTERFACE s_axilite port=C
+    #pragma HLS INTERFACE s_axilite port=P
     #pragma HLS INTERFACE s_axilite port=D
+    #pragma HLS INTERFACE s_axilite port=load_weights
     #pragma HLS INTERFACE s_axilite port=return
 
-    // Global streams linking the processes. 
-    // Static ensures persistence, depth prevents backpressure during bidirectional processing.
-    static hls::stream<PixelVec> stream_in("stream_in");
-    static hls::stream<PixelVec> stream_out("stream_out");
-    #pragma HLS STREAM variable=stream_in  depth=512
-    #pragma HLS STREAM variable=stream_out depth=512
+    // A frame past the buffers would overrun the reversal buffers and stall the
+    // frame-deep FIFOs; refuse it instead
+    if (!vim_geometry_ok(H, W, C, P, D)) return VIM_BAD_GEOMETRY;
 
-    // DATAFLOW enables task-level parallelism (Overlapping Input/Compute/Output)
-    #pragma HLS DATAFLOW
-    input_proc(H, W, D, image, stream_in);
-    mamba_proc(H, W, D, stream_in, stream_out);
-    write_back_burst(H, W, D, stream_out, output);
+    // The patch-embedding taps stay resident between frames; a frame runs only on taps
+    // laid out for its own C, P and D
+    if (load_weights) ImagePreprocess::load_weights(C, P, D, weights);
+    else if (!ImagePreprocess::weights_loaded(C, P, D)) return VIM_NO_WEIGHTS;
+
+    vim_frame(H, W, C, P, D, image, output);
+    return VIM_OK;
 }
\ No newline at end of file
@@ -2,10 +2,27 @@
 #define TOP_H
 
 #include "types.h"
+#include "image_preprocess.h"
 
-void vim_top(
-    int H, int W, int D,
-    const float *image,
+// vim_top status. A frame the on-chip buffers are not sized for is rejected before any
+// port is touched: 1 <= P <= H, W and P <= MAX_PATCH, 1 <= C <= MAX_IMG_C,
+// 1 <= D <= MAX_D, and (H / P) x (W / P) tokens of vec_beats(D) words must fit in
+// MAX_SEQ_LEN stream words, one row of patches in MAX_ROW_WORDS and the P x P taps in
+// MAX_PATCH_WORDS (image_preprocess.h). A frame without load_weights needs the
+// resident patch-embedding weights to have been loaded for the same C, P and D.
+const int VIM_OK = 0;
+const int VIM_BAD_GEOMETRY = 1;
+const int VIM_NO_WEIGHTS = 2;
+
+// image: H x W packed 8-bit pixels (pixel_t), of which the first C channels are used.
+// weights: the patch-embedding blob, embed_weights_size(C, P, D) values, read only when
+// load_weights is set.
+// output: one D-channel token per P x P patch, (H / P) x (W / P) tokens in raster order.
+int vim_top(
+    int H, int W, int C, int P, int D,
+    const pixel_t *image,
+    const ssm_t *weights,
+    int load_weights,
     float *output
 );
 
@@ -2,18 +2,37 @@
 #define TYPES_H
 
 #include <ap_fixed.h>
+#include <ap_int.h>
 
 typedef ap_fixed<24, 8, AP_RND, AP_SAT> ssm_t;
 
+// Input pixel as it sits in DDR: 8-bit channels R, G, B, A in bytes 0 .. 3
+typedef ap_uint<32> pixel_t;
+
+// Vector word: a stream word carries VEC_WIDTH channels. A token of D channels travels
+// as vec_beats(D) consecutive words (beat b holds channels b * VEC_WIDTH ..), so any D
+// up to MAX_D runs on the same 32-wide datapath, chosen at run time.
+const int VEC_WIDTH = 32;
+const int MAX_D = 512;
+
+inline int vec_beats(int d) {
+#pragma HLS INLINE
+    return (d + VEC_WIDTH - 1) / VEC_WIDTH;
+}
+
+// Largest frame the on-chip reversal buffers are sized for, in stream words
+// (H * W * vec_beats(D))
+const int MAX_SEQ_LEN = 1024;
+
 struct PixelVec {
-    ssm_t data[32]; 
+    ssm_t data[VEC_WIDTH]; 
 };
 
 struct S6Params {
-    ssm_t delta[32];
-    ssm_t B[32];
-    ssm_t C[32];
-    ssm_t x[32];
+    ssm_t delta[VEC_WIDTH];
+    ssm_t B[VEC_WIDTH];
+    ssm_t C[VEC_WIDTH];
+    ssm_t x[VEC_WIDTH];
 };
 
 #endif
\ No newline at end of file
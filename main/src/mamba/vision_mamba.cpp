@@ -7,7 +7,11 @@ VisionMambaBlock::VisionMambaBlock(int h, int w, int d)
       conv(d), 
       param_gen(d), 
       ssm(d), 
-      out_block(d) 
+      out_block(d),
+      conv_bwd(d),
+      param_gen_bwd(d),
+      ssm_bwd(d),
+      reverser(d)
 {}
 
 void VisionMambaBlock::run(
@@ -17,6 +21,7 @@ void VisionMambaBlock::run(
     #pragma HLS DATAFLOW
 
     int L = H * W;
+    int words = L * vec_beats(D); // Stream words per frame
 
     static hls::stream<PixelVec> s_residual_copy("s_res");
     static hls::stream<PixelVec> s_norm_out("s_norm");
@@ -26,19 +31,42 @@ void VisionMambaBlock::run(
     static hls::stream<S6Params> s_params("s_params");
     static hls::stream<PixelVec> s_ssm_out("s_ssm");
 
+    // Backward path streams
+    static hls::stream<PixelVec> s_main_fwd("s_main_fwd");
+    static hls::stream<PixelVec> s_main_bwd("s_main_bwd");
+    static hls::stream<PixelVec> s_rev_in("s_rev_in");
+    static hls::stream<PixelVec> s_conv_bwd("s_conv_bwd");
+    static hls::stream<S6Params> s_params_bwd("s_params_bwd");
+    static hls::stream<PixelVec> s_ssm_bwd_rev("s_ssm_bwd_rev");
+    static hls::stream<PixelVec> s_ssm_bwd("s_ssm_bwd");
+
+    // Frame-sized reversal buffers (ping-pong between store and load_reversed)
+    PixelVec rev_in_buf[MAX_SEQ_LEN];
+    PixelVec rev_out_buf[MAX_SEQ_LEN];
+
     // FIFO Depths
-    #pragma HLS STREAM variable=s_residual_copy depth=1024 // Needs to store data while others process
-    #pragma HLS STREAM variable=s_gate_branch   depth=1024 // Delay match for Gate
+    // The backward scan can only start once a whole frame is buffered, so every
+    // stream that bypasses it (residual, gate, forward scan) must hold a frame:
+    // MAX_SEQ_LEN words, the largest frame vim_top accepts.
+    #pragma HLS STREAM variable=s_residual_copy depth=MAX_SEQ_LEN // Needs to store data while others process
+    #pragma HLS STREAM variable=s_gate_branch   depth=MAX_SEQ_LEN // Delay match for Gate
+    #pragma HLS STREAM variable=s_ssm_out       depth=MAX_SEQ_LEN // Delay match for the backward scan
     #pragma HLS STREAM variable=s_norm_out      depth=4
     #pragma HLS STREAM variable=s_main_branch   depth=4
     #pragma HLS STREAM variable=s_conv_out      depth=4
     #pragma HLS STREAM variable=s_params        depth=4
-    #pragma HLS STREAM variable=s_ssm_out       depth=4
+    #pragma HLS STREAM variable=s_main_fwd      depth=4
+    #pragma HLS STREAM variable=s_main_bwd      depth=4
+    #pragma HLS STREAM variable=s_rev_in        depth=4
+    #pragma HLS STREAM variable=s_conv_bwd      depth=4
+    #pragma HLS STREAM variable=s_params_bwd    depth=4
+    #pragma HLS STREAM variable=s_ssm_bwd_rev   depth=4
+    #pragma HLS STREAM variable=s_ssm_bwd       depth=4
 
     static hls::stream<PixelVec> s_input_to_norm("s_in_norm");
     #pragma HLS STREAM variable=s_input_to_norm depth=4
     
-    for(int t=0; t<L; t++) {
+    for(int t=0; t<words; t++) {
         #pragma HLS PIPELINE II=1
         PixelVec p = input_stream.read();
         s_residual_copy.write(p); 
@@ -52,15 +80,23 @@ void VisionMambaBlock::run(
     // RMSNorm -> (Main, Gate)
     in_proj.forward(L, s_norm_out, s_main_branch, s_gate_branch);
 
-    // Main -> Conv1D
-    conv.forward(L, s_main_branch, s_conv_out);
+    // Main -> (Forward, Backward)
+    splitter.forward(words, s_main_branch, s_main_fwd, s_main_bwd);
 
-    // Conv1D -> Params
+    // Forward: Main -> Conv1D -> Params -> SSM Core
+    conv.forward(L, s_main_fwd, s_conv_out);
     param_gen.forward(L, s_conv_out, s_params);
-
-    // Params -> SSM Core
     ssm.forward(L, s_params, s_ssm_out);
 
-    // (SSM, Gate, Residual) -> Output
-    out_block.forward(L, s_ssm_out, s_gate_branch, s_residual_copy, output_stream);
+    // Backward: reverse tokens -> Conv1D -> Params -> SSM Core -> restore token order
+    reverser.store(L, s_main_bwd, rev_in_buf);
+    reverser.load_reversed(L, rev_in_buf, s_rev_in);
+    conv_bwd.forward(L, s_rev_in, s_conv_bwd);
+    param_gen_bwd.forward(L, s_conv_bwd, s_params_bwd);
+    ssm_bwd.forward(L, s_params_bwd, s_ssm_bwd_rev);
+    reverser.store(L, s_ssm_bwd_rev, rev_out_buf);
+    reverser.load_reversed(L, rev_out_buf, s_ssm_bwd);
+
+    // (SSM fwd, SSM bwd, Gate, Residual) -> Output
+    out_block.forward(L, s_ssm_out, s_ssm_bwd, s_gate_branch, s_residual_copy, output_stream);
 }
\ No newline at end of file
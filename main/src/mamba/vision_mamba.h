@@ -20,6 +20,12 @@ public:
     OutputBlock out_block;
     Splitter splitter;
 
+    // Backward scan path (own conv history and S6 state, runs concurrently)
+    Conv1DBlock conv_bwd;
+    S6ParamGen param_gen_bwd;
+    S6Layer ssm_bwd;
+    TokenReverser reverser;
+
     VisionMambaBlock(int h, int w, int d);
 
     void run(